@@ -0,0 +1,83 @@
+#include <stromboli/stromboli.h>
+#include <stromboli/stromboli_render_graph.h>
+#include <grounded/memory/grounded_arena.h>
+
+#include <stdio.h>
+#include <time.h>
+
+// Measures the CPU time of building and compiling synthetic render graphs. Runs without a window or swapchain.
+// Every pass renders into a new image and samples the outputs of the previous pass and of the pass at half its index.
+// So there are short lived images that can be aliased, long lived images and producers with many consumers.
+
+#define SYNTHETIC_IMAGE_SIZE 64
+
+static double getSeconds(void) {
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+static RenderGraphBuilder* buildSyntheticGraph(StromboliContext* context, MemoryArena* arena, u32 passCount, RenderGraphImageHandle* finalOutput) {
+    RenderGraphBuilder* builder = createRenderGraphBuilder(context, arena);
+    RenderGraphImageHandle* outputs = ARENA_PUSH_ARRAY(arena, passCount, RenderGraphImageHandle);
+    for(u32 i = 0; i < passCount; ++i) {
+        RenderGraphPassHandle pass = renderGraphAddGraphicsPass(builder, STR8_LITERAL("Synthetic pass"));
+        if(i > 0) {
+            renderPassAddInput(builder, pass, outputs[i-1], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_IMAGE_USAGE_SAMPLED_BIT);
+        }
+        if(i > 2) {
+            renderPassAddInput(builder, pass, outputs[i/2], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_IMAGE_USAGE_SAMPLED_BIT);
+        }
+        outputs[i] = renderPassAddOutput(builder, pass, SYNTHETIC_IMAGE_SIZE, SYNTHETIC_IMAGE_SIZE, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_FORMAT_R8G8B8A8_UNORM, 0);
+    }
+    *finalOutput = outputs[passCount-1];
+    return builder;
+}
+
+int main() {
+    StromboliContext context = {0};
+    StromboliInitializationParameters parameters = {
+        .applicationName = STR8_LITERAL("Render Graph Benchmark"),
+        .vulkanApiVersion = VK_API_VERSION_1_3,
+        .disableSwapchain = true,
+        .dynamicRendering = true,
+        .synchronization2 = true,
+    };
+    StromboliResult error = initStromboli(&context, &parameters);
+    if(STROMBOLI_ERROR(error)) {
+        printf("Failed to initialize Stromboli: %.*s\n", (int)error.errorString.size, (const char*)error.errorString.base);
+        return 1;
+    }
+
+    MemoryArena arena = createGrowingArena(osGetMemorySubsystem(), KB(4));
+    ArenaMarker marker = arenaCreateMarker(&arena);
+    const u32 passCounts[] = {10, 100, 1000, 10000};
+    printf("%8s %12s %12s %18s\n", "passes", "build [ms]", "compile [ms]", "compile/pass [us]");
+    for(u32 i = 0; i < ARRAY_COUNT(passCounts); ++i) {
+        u32 passCount = passCounts[i];
+        // Roughly the same number of passes per row so small graphs are not dominated by timer resolution
+        u32 iterationCount = MAX(10000 / passCount, 5);
+        double buildSeconds = 0.0;
+        double compileSeconds = 0.0;
+        for(u32 iteration = 0; iteration < iterationCount; ++iteration) {
+            RenderGraphImageHandle finalOutput;
+            double start = getSeconds();
+            RenderGraphBuilder* builder = buildSyntheticGraph(&context, &arena, passCount, &finalOutput);
+            double built = getSeconds();
+            RenderGraph* graph = renderGraphCompile(builder, finalOutput, 0);
+            double compiled = getSeconds();
+            buildSeconds += built - start;
+            compileSeconds += compiled - built;
+
+            renderGraphDestroy(graph);
+            arenaResetToMarker(marker);
+        }
+        buildSeconds /= iterationCount;
+        compileSeconds /= iterationCount;
+        printf("%8u %12.3f %12.3f %18.3f\n", passCount, buildSeconds * 1000.0, compileSeconds * 1000.0, compileSeconds * 1000000.0 / passCount);
+    }
+
+    arenaRelease(&arena);
+    shutdownStromboli(&context);
+    return 0;
+}
@@ -34,6 +34,7 @@ typedef struct StromboliContext {
     VkPhysicalDeviceLimits physicalDeviceLimits;
     VkPhysicalDeviceFeatures physicalDeviceFeatures;
     VkDevice device;
+    bool timelineSemaphore; // The timelineSemaphore feature is enabled. Requires VK_API_VERSION_1_2
 
     // Queues
     StromboliQueue queues[MAX_QUEUE_COUNT];
@@ -179,6 +180,7 @@ typedef struct StromboliInitializationParameters {
 
     // Features
     bool depthClampFeature;
+    bool multiview;
     bool shaderInt64;
     bool descriptorUpdateTemplate;
     bool disableSwapchain;
@@ -293,6 +295,8 @@ typedef struct StromboliGraphicsPipelineParameters {
 
     VkDescriptorSetLayout setLayotus[4]; // Optionally overwrite descriptor set layouts
 
+    u32 viewMask; // Multiview view mask for dynamic rendering. Must match the view mask of the pass the pipeline is used in
+
     bool wireframe;
     bool depthTest;
     bool depthWrite;
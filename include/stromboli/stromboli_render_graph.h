@@ -17,7 +17,8 @@
 
 // Render Graph does not overlap the execution of one graph with the next. 
 // However there might still be an overlap between
-// Recording and Execution which would make double buffering necessary.
+// Recording and Execution. Up to RENDER_GRAPH_FRAMES_IN_FLIGHT executions can be pending on the GPU.
+// Every frame slot has its own command buffers, queries and fence so the CPU only blocks once it laps the GPU.
 
 #ifndef RENDER_GRAPH_H
 #define RENDER_GRAPH_H
@@ -25,6 +26,15 @@
 #include <stromboli/stromboli.h>
 #include <grounded/memory/grounded_arena.h>
 
+#ifndef RENDER_GRAPH_FRAMES_IN_FLIGHT
+#define RENDER_GRAPH_FRAMES_IN_FLIGHT 2
+#endif
+
+// Number of host buffers per readback pass. The data of an execution stays available until the readback pass is recorded again this many executions later
+#ifndef RENDER_GRAPH_READBACK_RING_SIZE
+#define RENDER_GRAPH_READBACK_RING_SIZE (RENDER_GRAPH_FRAMES_IN_FLIGHT + 2)
+#endif
+
 typedef struct RenderGraph RenderGraph;
 typedef struct RenderGraphBuilder RenderGraphBuilder;
 typedef struct RenderGraphPass RenderGraphPass;
@@ -34,13 +44,74 @@ typedef struct  RenderGraphPassHandle {
 } RenderGraphPassHandle;
 typedef struct RenderGraphImageHandle {
     u32 handle; // Upper FINGERPRINT_BITS (default 8) bits store a frame fingerprint
+    u32 subresource; // Mip level and array layer selected by renderGraphImageGetSubresource. 0 selects the whole image
 } RenderGraphImageHandle;
+typedef struct RenderGraphBufferHandle {
+    u32 handle; // Upper FINGERPRINT_BITS (default 8) bits store a frame fingerprint
+} RenderGraphBufferHandle;
 
 struct RenderPassOutputParameters {
     bool clear;
     VkResolveModeFlags resolveMode;
     VkClearValue clearValue;
     VkSampleCountFlags sampleCount;
+    // Scale of the output size set with renderGraphSetOutputSize or renderGraphImportSwapchain. If nonzero width and height are ignored
+    // and the image follows the output size. Such images are recreated by renderGraphResize
+    float relativeWidth;
+    float relativeHeight;
+    u32 mipCount; // 0 means 1. A graphics pass creating the image only renders into mip 0. Other mips have to be written through renderGraphImageGetSubresource
+    u32 layerCount; // 0 means 1
+};
+
+// Selects all mip levels or array layers in renderGraphImageGetSubresource
+#define RENDER_GRAPH_ALL_MIPS UINT32_MAX
+#define RENDER_GRAPH_ALL_LAYERS UINT32_MAX
+
+// How independent passes are ordered after the topological sort
+enum RenderGraphScheduleMode {
+    RENDER_GRAPH_SCHEDULE_NONE = 0, // Keeps the order of the topological sort. Useful for debugging
+    RENDER_GRAPH_SCHEDULE_OVERLAP, // Default. Maximizes the distance between producers and consumers so barriers stall less
+    RENDER_GRAPH_SCHEDULE_MEMORY, // Minimizes the number of images alive at once so more memory can be aliased
+};
+
+struct RenderGraphMemoryStatistics {
+    u64 peakMemory; // Memory bound to graph images. Images with disjoint lifetimes share memory
+    u64 unaliasedMemory; // Memory the same images would require without aliasing
+    u64 aliasedMemory; // Memory saved by aliasing
+    u64 lazilyAllocatedMemory; // Part of peakMemory in lazily allocated memory. Tile based GPUs usually never back it with physical memory
+    u32 imageCount;
+    u32 aliasedImageCount;
+    u32 transientImageCount; // Attachments that only live inside a single graphics pass. Created as transient attachments
+    u32 reusedImageCount; // Images taken over from the previous compilation instead of being recreated
+};
+
+struct RenderGraphPassTiming {
+    String8 name; // Owned by the graph. Only valid until the next recompilation
+    float last; // All durations in seconds
+    float mean;
+    float min;
+    float p95;
+};
+
+struct RenderGraphReadbackData {
+    const void* data; // Tightly packed rows of width * texelSize bytes. Owned by the graph
+    u64 size;
+    u32 width; // Render extent of the image in the execution. Smaller than the image while the render scale is below 1
+    u32 height;
+    u32 texelSize;
+    VkFormat format;
+};
+
+struct RenderGraphBarrierStatistics {
+    u32 barrierCount; // Image and buffer barriers recorded per execution
+    u32 removedBarrierCount; // Read after read barriers and repeated uses within one pass that were removed while compiling
+    u32 splitBarrierCount; // Part of barrierCount. Signaled by an event after the producing pass and waited for right before the consumer
+};
+
+struct RenderGraphSubmitStatistics {
+    u32 passCount; // Every pass gets its own command buffer without pass batching
+    u32 commandBufferCount; // Command buffers recorded and submitted per execution
+    u32 submitCount; // Submit batches per execution
 };
 
 // Build
@@ -50,31 +121,104 @@ RenderGraphPassHandle renderGraphAddTransferPass(RenderGraphBuilder* builder, St
 RenderGraphPassHandle renderGraphAddComputePass(RenderGraphBuilder* builder, String8 name);
 RenderGraphPassHandle renderGraphAddRaytracePass(RenderGraphBuilder* builder, String8 name);
 RenderGraphImageHandle renderGraphCreateClearedFramebuffer(RenderGraphBuilder* builder, u32 width, u32 height, VkFormat format, VkSampleCountFlags sampleCount, VkClearValue clearColor);
+// Image with the size and format of the swapchain. clearColor is optional. If the swapchain output is derived from it and only written by a single graphics pass,
+// that pass renders directly into the acquired swapchain image instead of blitting into it after the pass
+RenderGraphImageHandle renderGraphImportSwapchain(RenderGraphBuilder* builder, StromboliSwapchain* swapchain, VkClearValue* clearColor);
 
 RenderGraphImageHandle renderPassAddOutput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, u32 width, u32 height, VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags2 stage, VkImageUsageFlags usage, VkFormat format, struct RenderPassOutputParameters* parameters);
 RenderGraphImageHandle renderPassAddInput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, RenderGraphImageHandle input, VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags2 stage, VkImageUsageFlags usage);
 RenderGraphImageHandle renderPassAddInputOutput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, RenderGraphImageHandle input, VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags2 stage, VkImageUsageFlags usage, VkResolveModeFlags resolve);
 
+// Buffers are transient and only live for the duration of a graph execution. Their content is undefined until a pass writes it
+RenderGraphBufferHandle renderGraphCreateClearedBuffer(RenderGraphBuilder* builder, u64 size, u32 clearValue); // The first pass writing the buffer fills it with clearValue. Usefull for counters
+RenderGraphBufferHandle renderPassAddBufferOutput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, u64 size, VkAccessFlags2 access, VkPipelineStageFlags2 stage, VkBufferUsageFlags usage);
+RenderGraphBufferHandle renderPassAddBufferInput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, RenderGraphBufferHandle input, VkAccessFlags2 access, VkPipelineStageFlags2 stage, VkBufferUsageFlags usage);
+RenderGraphBufferHandle renderPassAddBufferInputOutput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, RenderGraphBufferHandle input, VkAccessFlags2 access, VkPipelineStageFlags2 stage, VkBufferUsageFlags usage);
+
+// Copies image into host memory owned by the graph. The pass is recorded automatically if it is not begun. If format differs from the format of image,
+// the image is blitted into an image of that format first. Depth images can only be read back in their own format. Multisampled images have to be resolved first.
+// Only mip 0 of layer 0 is read back
+RenderGraphPassHandle renderGraphAddReadbackPass(RenderGraphBuilder* builder, String8 name, RenderGraphImageHandle image, VkFormat format);
+
 void renderPassSetExternal(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, bool external); // Marks the render pass as producing external resources. This makes sure the pass is not pruned when compiling
+void renderPassSetAsync(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, bool async); // Allows a compute pass to run on a dedicated compute queue in parallel to graphics work. Ignored if the context has no compute queue
+// Static passes record the same commands every execution. They are recorded once per frame slot and replayed until the graph is recompiled, resized,
+// the render scale or a clear value changes or renderGraphInvalidateStaticPass is called. beginRenderPass returns 0 while the pass is replayed.
+// Ignored for the pass producing the swapchain output
+void renderPassSetStatic(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, bool isStatic);
+// Lets worker threads record the draws of a graphics pass into count secondary command buffers. See renderPassGetSecondaryCommandBuffer
+void renderPassSetSecondaryCommandBufferCount(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, u32 count);
+// Multiview rendering. Every draw of the pass is broadcast to each output layer i with bit i set in viewMask, eg. 0x3F for the 6 faces of a cubemap.
+// Outputs must contain all selected layers. Requires the multiview device feature and pipelines created with the same viewMask
+void renderPassSetViewMask(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, u32 viewMask);
+void renderGraphSetScheduleMode(RenderGraphBuilder* builder, enum RenderGraphScheduleMode mode);
+// Records consecutive passes of the same submit batch into a single command buffer to reduce the per command buffer overhead. Barriers stay the same.
+// Batched passes have to be begun in execution order on thread 0. Beginning a pass finishes the previous pass of its command buffer.
+// Static passes and passes with secondary command buffers are never batched
+void renderGraphSetPassBatching(RenderGraphBuilder* builder, bool batch);
+void renderGraphSetOutputSize(RenderGraphBuilder* builder, u32 width, u32 height); // Reference size for outputs with a relative size. Must be set before adding them
 VkFormat renderGraphImageGetFormat(RenderGraphBuilder* builder, RenderGraphImageHandle image);
 u32 renderGraphImageGetWidth(RenderGraphBuilder* builder, RenderGraphImageHandle image);
 u32 renderGraphImageGetHeight(RenderGraphBuilder* builder, RenderGraphImageHandle image);
 VkSampleCountFlags renderGraphImageGetSampleCount(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle);
+u32 renderGraphImageGetMipCount(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle);
+u32 renderGraphImageGetLayerCount(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle);
+// Handle of a single mip level and/or array layer of image. Passes using it only synchronize with accesses of the same subresources,
+// so a pass can read mip N while writing mip N+1. Resources of such handles have a view and size of the subresource
+RenderGraphImageHandle renderGraphImageGetSubresource(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle, u32 mipLevel, u32 arrayLayer);
+u64 renderGraphBufferGetSize(RenderGraphBuilder* builder, RenderGraphBufferHandle bufferHandle);
 //RenderGraphImageHandle renderGraphImageResolve(RenderGraphBuilder* builder, RenderGraphImageHandle image); // Resolves a multi sampled image into a nonmultisampled image (or does nothing if input is not multisampled)
 
 // Compile. RenderGraph uses its own arena after this so you are save to reset the arena used for the builder
+// When the builder is structurally identical to oldGraph (same passes, attachments and resources) oldGraph is reused without recompilation
+// If only the output size differs, oldGraph is resized instead
 RenderGraph* renderGraphCompile(RenderGraphBuilder* builder, RenderGraphImageHandle swapchainOutput, RenderGraph* oldGraph);
-void renderGraphDestroy(RenderGraph* graph, VkFence fence);
+// Recreates only the images with a relative size for the new output size. Pass order, barriers and command buffers are kept. Old images are destroyed once pending executions are done
+void renderGraphResize(RenderGraph* graph, u32 width, u32 height);
+void renderGraphDestroy(RenderGraph* graph); // Waits for all pending executions
+// Background compilation. renderGraphCompile without an oldGraph touches no other graph, so it can run on a worker thread while the current graph keeps executing.
+// The compiled graph does not reuse any resources of the current graph. Both graphs keep their resources until the old one is destroyed after the swap.
+void renderGraphSetPending(RenderGraph* graph, RenderGraph* compiledGraph); // Thread safe. compiledGraph replaces graph at the next renderGraphSwapPending. A pending graph that was not swapped in yet is destroyed
+RenderGraph* renderGraphSwapPending(RenderGraph* graph); // Call on the render thread between executions. Returns the graph to execute from now on. A replaced graph is destroyed once the first execution of its successor has finished
+struct RenderGraphMemoryStatistics renderGraphGetMemoryStatistics(RenderGraph* graph);
+struct RenderGraphBarrierStatistics renderGraphGetBarrierStatistics(RenderGraph* graph);
+struct RenderGraphSubmitStatistics renderGraphGetSubmitStatistics(RenderGraph* graph);
 
 // Execute
-RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle pass);
-u32 renderGraphGetFrameIndex(RenderGraph* graph);
+RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle pass); // Same as beginRenderPassOnThread with threadIndex 0. Returns 0 if the swapchain image for a direct swapchain output could not be acquired
+void renderGraphSetRecordingThreadCount(RenderGraph* graph, u32 threadCount); // Creates command pools for the recording threads. Must not be called while passes are recorded
+RenderGraphPass* beginRenderPassOnThread(RenderGraph* graph, RenderGraphPassHandle pass, u32 threadIndex); // Can be called concurrently for different passes as long as every thread uses its own threadIndex. Static passes are only replayed when begun on thread 0
+void renderGraphInvalidateStaticPass(RenderGraph* graph, RenderGraphPassHandle pass); // The static pass is recorded again in every frame slot. Call between executions
+u32 renderGraphGetFrameIndex(RenderGraph* graph); // Frame slot currently recorded. In range [0, RENDER_GRAPH_FRAMES_IN_FLIGHT)
 bool renderPassIsActive(RenderGraphPass* pass);
 VkCommandBuffer renderPassGetCommandBuffer(RenderGraphPass* pass);
+// Begins secondary command buffer index of a pass with secondary command buffers. Attachment formats, viewport and scissor are already set. Can be called
+// concurrently for different indices as long as every thread uses its own threadIndex. The recording thread ends it with vkEndCommandBuffer before renderGraphExecute.
+// The graph executes them in index order at the end of the pass. Commands must not be recorded into the primary command buffer of such a pass
+VkCommandBuffer renderPassGetSecondaryCommandBuffer(RenderGraphPass* pass, u32 index, u32 threadIndex);
 StromboliImage* renderPassGetInputResource(RenderGraphPass* pass, RenderGraphImageHandle image);
 StromboliImage* renderPassGetOutputResource(RenderGraphPass* pass, RenderGraphImageHandle image);
-bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain, VkFence fence); // Returns false if swapchain must be resized
+StromboliBuffer* renderPassGetBufferResource(RenderGraphPass* pass, RenderGraphBufferHandle buffer);
+VkExtent2D renderPassGetRenderExtent(RenderGraphPass* pass, RenderGraphImageHandle image); // Part of the image that is rendered in this execution. Smaller than the image for relative images while the render scale is below 1
+bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain); // Returns false if swapchain must be resized. Blocks only if the next frame slot is still executing
+// Executes a graph compiled without renderGraphImportSwapchain without acquiring or presenting. The final image is left in finalLayout after its producing pass,
+// so later passes must not access it. Returns the value the timeline semaphore reaches once the execution has finished. Requires the timelineSemaphore device feature, see StromboliInitializationParameters.timelineSemaphore
+u64 renderGraphExecuteOffscreen(RenderGraph* graph, VkImageLayout finalLayout);
+void renderGraphWaitOffscreen(RenderGraph* graph, u64 timelineValue); // Blocks until the offscreen execution that returned timelineValue has finished
+VkSemaphore renderGraphGetTimelineSemaphore(RenderGraph* graph); // 0 before the first offscreen execution. Can be waited for in other submissions
 float renderGraphGetLastDuration(RenderGraph* graph); // Result in seconds
+u64 renderGraphGetExecutionIndex(RenderGraph* graph); // Index of the execution that is currently recorded. Increases with every submitted execution
+// Returns false if the execution has not finished yet (only when not waiting), was never submitted or its data has already been overwritten.
+// Readbacks of executions before a recompilation are lost
+bool renderGraphGetReadback(RenderGraph* graph, RenderGraphPassHandle readbackPass, u64 executionIndex, bool wait, struct RenderGraphReadbackData* result);
+void renderGraphSetTimingWindow(RenderGraph* graph, u32 frameCount); // Number of executions the pass timing statistics are computed over. Resets the collected timings
+// Dynamic resolution. Images with a relative size keep their allocation and are only rendered into their top left scale part. Graphics passes set render area,
+// viewport and scissor accordingly and the final blit upscales the active part. A swapchain output that is rendered directly always uses the full size.
+// Changes take effect for passes begun afterwards so only call these between executions
+void renderGraphSetRenderScale(RenderGraph* graph, float scale); // In range (0, 1]
+float renderGraphGetRenderScale(RenderGraph* graph);
+void renderGraphSetTargetFrameTime(RenderGraph* graph, float seconds); // Adjusts the render scale after every execution so the graph takes about seconds on the GPU. 0 disables the controller
+u32 renderGraphGetPassTimings(RenderGraph* graph, struct RenderGraphPassTiming* timings, u32 maxTimingCount); // Writes timings in execution order and returns the number of timed passes. Timings lag RENDER_GRAPH_FRAMES_IN_FLIGHT - 1 executions behind
 
 // Debug
 void renderGraphBuilderPrint(RenderGraphBuilder* builder);
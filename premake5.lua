@@ -144,4 +144,24 @@ project "vma"
         buildoptions
         {
             "-Wno-error",
-        }
\ No newline at end of file
+        }
+project "RenderGraphBenchmark"
+    targetdir "bin/benchmarks/%{cfg.buildcfg:lower()}"
+    files
+    {
+        "benchmarks/render_graph_benchmark.c",
+        "src/render_graph/render_graph.c",
+    }
+    links
+    {
+        "StromboliStatic",
+        "GroundedStatic",
+        "vma",
+    }
+    filter "system:linux"
+        links
+        {
+            "dl",
+            "m",
+            "pthread",
+        }
@@ -1,9 +1,26 @@
 #include <stromboli/stromboli_render_graph.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "render_graph_definitions.inl"
 
 static u32 builderFingerprint;
 
+// Builders can be created on any thread, eg. for background compilation. The counter is incremented atomically so concurrently created builders
+// still get different fingerprints
+static u32 nextBuilderFingerprint(void) {
+#ifdef _MSC_VER
+    u32 result = (u32)_InterlockedIncrement((volatile long*)&builderFingerprint) - 1;
+#else
+    u32 result = __atomic_fetch_add(&builderFingerprint, 1, __ATOMIC_RELAXED);
+#endif
+    return result & ((1 << FINGERPRINT_BITS) - 1);
+}
+
 // Arena is used for building the graph. The compile step then uses its own arena stored as part of the render graph
 // You are responsible to reset the frameArena memory sometime after RenderGraph has been compiled
 RenderGraphBuilder* createRenderGraphBuilder(StromboliContext* context, MemoryArena* frameArena) {
@@ -12,62 +29,100 @@ RenderGraphBuilder* createRenderGraphBuilder(StromboliContext* context, MemoryAr
         result->arena = frameArena;
         result->context = context;
         result->currentPassIndex = 1;
-        result->fingerprint = builderFingerprint;
+        result->fingerprint = nextBuilderFingerprint();
+        result->scheduleMode = RENDER_GRAPH_SCHEDULE_OVERLAP;
     }
-    builderFingerprint = (builderFingerprint+1) & ((1<<FINGERPRINT_BITS) - 1);
 
     return result;
 }
 
-RenderGraphPassHandle renderGraphAddGraphicsPass(RenderGraphBuilder* builder, String8 name) {
-    RenderGraphPassHandle result = {0};
-    struct RenderGraphBuildPass* pass = ARENA_PUSH_STRUCT(builder->arena, struct RenderGraphBuildPass);
-
-    if(pass) {
-        pass->next = builder->passSentinel.next;
-        builder->passSentinel.next = pass;
-        pass->name = name;
-        pass->type = RENDER_GRAPH_PASS_TYPE_GRAPHICS;
-
-        result.handle = builder->currentPassIndex++;
-        ASSERT(result.handle < INVERSE_FINGERPRINT_MASK);
-        result.handle |= builder->fingerprint << FINGERPRINT_SHIFT;
-        ASSERT(isPassFingerprintValid(builder, result));
-        ASSERT(getPassHandleData(result) == builder->currentPassIndex-1);
+static struct RenderGraphBuildPass* pushBuildPass(RenderGraphBuilder* builder) {
+    if(builder->currentPassIndex - 1 >= builder->passCapacity) {
+        u32 newCapacity = MAX(builder->passCapacity * 2, 32);
+        struct RenderGraphBuildPass* newPasses = ARENA_PUSH_ARRAY_NO_CLEAR(builder->arena, newCapacity, struct RenderGraphBuildPass);
+        if(!newPasses) {
+            return 0;
+        }
+        if(builder->passes) {
+            MEMORY_COPY(newPasses, builder->passes, sizeof(struct RenderGraphBuildPass) * builder->passCapacity);
+        }
+        builder->passes = newPasses;
+        builder->passCapacity = newCapacity;
     }
-    
+    struct RenderGraphBuildPass* result = &builder->passes[builder->currentPassIndex - 1];
+    MEMORY_CLEAR_STRUCT(result);
     return result;
 }
 
-RenderGraphPassHandle renderGraphAddTransferPass(RenderGraphBuilder* builder, String8 name) {
-    RenderGraphPassHandle result = {0};
-    struct RenderGraphBuildPass* pass = ARENA_PUSH_STRUCT(builder->arena, struct RenderGraphBuildPass);
+static struct RenderGraphBuildImage* pushBuildImage(RenderGraphBuilder* builder) {
+    if(builder->currentResourceIndex >= builder->imageCapacity) {
+        u32 newCapacity = MAX(builder->imageCapacity * 2, 64);
+        struct RenderGraphBuildImage* newImages = ARENA_PUSH_ARRAY_NO_CLEAR(builder->arena, newCapacity, struct RenderGraphBuildImage);
+        if(!newImages) {
+            return 0;
+        }
+        if(builder->images) {
+            MEMORY_COPY(newImages, builder->images, sizeof(struct RenderGraphBuildImage) * builder->imageCapacity);
+        }
+        builder->images = newImages;
+        builder->imageCapacity = newCapacity;
+    }
+    struct RenderGraphBuildImage* result = &builder->images[builder->currentResourceIndex];
+    MEMORY_CLEAR_STRUCT(result);
+    result->image.mipCount = 1;
+    result->layerCount = 1;
+    return result;
+}
 
-    if(pass) {
-        pass->next = builder->passSentinel.next;
-        builder->passSentinel.next = pass;
-        pass->name = name;
-        pass->type = RENDER_GRAPH_PASS_TYPE_TRANSFER;
+static struct RenderGraphBuildBuffer* pushBuildBuffer(RenderGraphBuilder* builder) {
+    if(builder->currentBufferIndex >= builder->bufferCapacity) {
+        u32 newCapacity = MAX(builder->bufferCapacity * 2, 32);
+        struct RenderGraphBuildBuffer* newBuffers = ARENA_PUSH_ARRAY_NO_CLEAR(builder->arena, newCapacity, struct RenderGraphBuildBuffer);
+        if(!newBuffers) {
+            return 0;
+        }
+        if(builder->buffers) {
+            MEMORY_COPY(newBuffers, builder->buffers, sizeof(struct RenderGraphBuildBuffer) * builder->bufferCapacity);
+        }
+        builder->buffers = newBuffers;
+        builder->bufferCapacity = newCapacity;
+    }
+    struct RenderGraphBuildBuffer* result = &builder->buffers[builder->currentBufferIndex];
+    MEMORY_CLEAR_STRUCT(result);
+    return result;
+}
 
-        result.handle = builder->currentPassIndex++;
-        ASSERT(result.handle < INVERSE_FINGERPRINT_MASK);
-        result.handle |= builder->fingerprint << FINGERPRINT_SHIFT;
-        ASSERT(isPassFingerprintValid(builder, result));
-        ASSERT(getPassHandleData(result) == builder->currentPassIndex-1);
+// Checked in all builds. An image index overflowing into the fingerprint would silently alias another image
+static RenderGraphImageHandle createImageHandle(RenderGraphBuilder* builder) {
+    RenderGraphImageHandle result = {0};
+    if(builder->currentResourceIndex >= INVERSE_FINGERPRINT_MASK) {
+        fprintf(stderr, "Render graph builder exceeded the maximum of %u images\n", INVERSE_FINGERPRINT_MASK);
+        abort();
     }
-    
+    result.handle = builder->currentResourceIndex++;
+    result.handle |= builder->fingerprint << FINGERPRINT_SHIFT;
+    ASSERT(isImageFingerprintValid(builder, result));
+    ASSERT(getImageHandleData(result) == builder->currentResourceIndex-1);
     return result;
 }
 
-RenderGraphPassHandle renderGraphAddComputePass(RenderGraphBuilder* builder, String8 name) {
+static RenderGraphBufferHandle createBufferHandle(RenderGraphBuilder* builder) {
+    RenderGraphBufferHandle result = {0};
+    result.handle = builder->currentBufferIndex++;
+    ASSERT(result.handle < INVERSE_FINGERPRINT_MASK);
+    result.handle |= builder->fingerprint << FINGERPRINT_SHIFT;
+    ASSERT(isBufferFingerprintValid(builder, result));
+    ASSERT(getBufferHandleData(result) == builder->currentBufferIndex-1);
+    return result;
+}
+
+static RenderGraphPassHandle addPass(RenderGraphBuilder* builder, String8 name, enum RenderGraphPassType type) {
     RenderGraphPassHandle result = {0};
-    struct RenderGraphBuildPass* pass = ARENA_PUSH_STRUCT(builder->arena, struct RenderGraphBuildPass);
+    struct RenderGraphBuildPass* pass = pushBuildPass(builder);
 
     if(pass) {
-        pass->next = builder->passSentinel.next;
-        builder->passSentinel.next = pass;
         pass->name = name;
-        pass->type = RENDER_GRAPH_PASS_TYPE_COMPUTE;
+        pass->type = type;
 
         result.handle = builder->currentPassIndex++;
         ASSERT(result.handle < INVERSE_FINGERPRINT_MASK);
@@ -79,42 +134,52 @@ RenderGraphPassHandle renderGraphAddComputePass(RenderGraphBuilder* builder, Str
     return result;
 }
 
-RenderGraphPassHandle renderGraphAddRaytracePass(RenderGraphBuilder* builder, String8 name) {
-    RenderGraphPassHandle result = {0};
-    struct RenderGraphBuildPass* pass = ARENA_PUSH_STRUCT(builder->arena, struct RenderGraphBuildPass);
+RenderGraphPassHandle renderGraphAddGraphicsPass(RenderGraphBuilder* builder, String8 name) {
+    return addPass(builder, name, RENDER_GRAPH_PASS_TYPE_GRAPHICS);
+}
 
-    if(pass) {
-        pass->next = builder->passSentinel.next;
-        builder->passSentinel.next = pass;
-        pass->name = name;
-        pass->type = RENDER_GRAPH_PASS_TYPE_RAYTRACE;
+RenderGraphPassHandle renderGraphAddTransferPass(RenderGraphBuilder* builder, String8 name) {
+    return addPass(builder, name, RENDER_GRAPH_PASS_TYPE_TRANSFER);
+}
 
-        result.handle = builder->currentPassIndex++;
-        ASSERT(result.handle < INVERSE_FINGERPRINT_MASK);
-        result.handle |= builder->fingerprint << FINGERPRINT_SHIFT;
-        ASSERT(isPassFingerprintValid(builder, result));
-        ASSERT(getPassHandleData(result) == builder->currentPassIndex-1);
-    }
-    
-    return result;
+RenderGraphPassHandle renderGraphAddComputePass(RenderGraphBuilder* builder, String8 name) {
+    return addPass(builder, name, RENDER_GRAPH_PASS_TYPE_COMPUTE);
+}
+
+RenderGraphPassHandle renderGraphAddRaytracePass(RenderGraphBuilder* builder, String8 name) {
+    return addPass(builder, name, RENDER_GRAPH_PASS_TYPE_RAYTRACE);
 }
 
-static inline struct RenderGraphBuildPass* getPassFromHandle(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle) {
-    ASSERT(isPassFingerprintValid(builder, passHandle));
-    u32 passHandleValue = getPassHandleData(passHandle);
-    u32 stepCount = builder->currentPassIndex - passHandleValue - 1;
-    struct RenderGraphBuildPass* pass = builder->passSentinel.next;
-    for(u32 i = 0; i < stepCount; ++i) {
-        pass = pass->next;
+RenderGraphPassHandle renderGraphAddReadbackPass(RenderGraphBuilder* builder, String8 name, RenderGraphImageHandle image, VkFormat format) {
+    RenderGraphPassHandle result = addPass(builder, name, RENDER_GRAPH_PASS_TYPE_TRANSFER);
+    struct RenderGraphBuildPass* pass = getPassFromHandle(builder, result);
+    struct RenderGraphBuildImage* source = getImageFromHandle(builder, image);
+    if(!pass || !source) {
+        return result;
     }
-    return pass;
+    ASSERT(source->image.samples == VK_SAMPLE_COUNT_1_BIT); // Use renderGraphImageResolve first
+    ASSERT(getImageHandleMip(image) == 0 || getImageHandleMip(image) == UINT32_MAX); // Only mip 0 of layer 0 is read back
+    ASSERT(getImageHandleLayer(image) == 0 || getImageHandleLayer(image) == UINT32_MAX);
+    VkFormat sourceFormat = source->format;
+    struct RenderPassOutputParameters parameters = {0};
+    parameters.relativeWidth = source->widthScale;
+    parameters.relativeHeight = source->heightScale;
+    u32 width = source->image.width;
+    u32 height = source->image.height;
+
+    pass->readback = true;
+    pass->external = true; // Nothing inside the graph consumes the result
+    renderPassAddInput(builder, result, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_2_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    if(format && format != sourceFormat) {
+        ASSERT(!isDepthFormat(sourceFormat) && !isDepthFormat(format)); // Blits cannot convert depth formats
+        renderPassAddOutput(builder, result, width, height, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, format, &parameters);
+    }
+    return result;
 }
 
 RenderGraphImageHandle renderGraphCreateClearedFramebuffer(RenderGraphBuilder* builder, u32 width, u32 height, VkFormat format, VkSampleCountFlags sampleCount, VkClearValue clearColor) {
-    struct RenderGraphBuildImage* result = ARENA_PUSH_STRUCT(builder->arena, struct RenderGraphBuildImage);
+    struct RenderGraphBuildImage* result = pushBuildImage(builder);
     if(result) {
-        result->next = builder->imageSentinel.next;
-        builder->imageSentinel.next = result;
         result->image.width = width;
         result->image.height = height;
         result->format = format;
@@ -123,47 +188,69 @@ RenderGraphImageHandle renderGraphCreateClearedFramebuffer(RenderGraphBuilder* b
         result->clearColor = clearColor;
     }
 
-    RenderGraphImageHandle resultHandle = {0};
-    resultHandle.handle = builder->currentResourceIndex++;
-    ASSERT(resultHandle.handle < INVERSE_FINGERPRINT_MASK);
-    resultHandle.handle |= builder->fingerprint << FINGERPRINT_SHIFT;
-    ASSERT(isImageFingerprintValid(builder, resultHandle));
-    ASSERT(getImageHandleData(resultHandle) == builder->currentResourceIndex-1);
-    return resultHandle;
+    return createImageHandle(builder);
+}
+
+RenderGraphImageHandle renderGraphImportSwapchain(RenderGraphBuilder* builder, StromboliSwapchain* swapchain, VkClearValue* clearColor) {
+    ASSERT(!builder->swapchain || builder->swapchain == swapchain); // Only a single swapchain is supported
+    builder->swapchain = swapchain;
+    renderGraphSetOutputSize(builder, swapchain->width, swapchain->height);
+    VkClearValue clearValue = {0};
+    if(clearColor) {
+        clearValue = *clearColor;
+    }
+    RenderGraphImageHandle result = renderGraphCreateClearedFramebuffer(builder, swapchain->width, swapchain->height, swapchain->format, VK_SAMPLE_COUNT_1_BIT, clearValue);
+    struct RenderGraphBuildImage* image = getImageFromHandle(builder, result);
+    image->requiresClear = clearColor != 0;
+    // Follows the swapchain so a resize does not change the structure of the graph
+    image->widthScale = 1.0f;
+    image->heightScale = 1.0f;
+    return result;
 }
 
 RenderGraphImageHandle renderPassAddOutput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, u32 width, u32 height, VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags2 stage, VkImageUsageFlags usage, VkFormat format, struct RenderPassOutputParameters* parameters) {
-    struct RenderGraphBuildImage* result = ARENA_PUSH_STRUCT(builder->arena, struct RenderGraphBuildImage);
+    struct RenderGraphBuildImage* result = pushBuildImage(builder);
     struct RenderGraphBuildPass* pass = getPassFromHandle(builder, passHandle);
     if(!parameters) {
         static struct RenderPassOutputParameters defaultParameters = {0};
         parameters = &defaultParameters;
     }
+    if(parameters->relativeWidth > 0.0f || parameters->relativeHeight > 0.0f) {
+        ASSERT(parameters->relativeWidth > 0.0f && parameters->relativeHeight > 0.0f);
+        ASSERT(builder->outputWidth && builder->outputHeight); // renderGraphSetOutputSize has to be called first
+        width = getScaledSize(builder->outputWidth, parameters->relativeWidth);
+        height = getScaledSize(builder->outputHeight, parameters->relativeHeight);
+    }
 
-    RenderGraphImageHandle outputHandle = {0};
-    outputHandle.handle = builder->currentResourceIndex++;
-    ASSERT(outputHandle.handle < INVERSE_FINGERPRINT_MASK);
-    outputHandle.handle |= builder->fingerprint << FINGERPRINT_SHIFT;
-    ASSERT(isImageFingerprintValid(builder, outputHandle));
-    ASSERT(getImageHandleData(outputHandle) == builder->currentResourceIndex-1);
+    RenderGraphImageHandle outputHandle = createImageHandle(builder);
 
     if(result) {
-        result->producer = pass;
-        result->next = builder->imageSentinel.next;
+        result->producer = passHandle;
         result->image.width = width;
         result->image.height = height;
+        result->widthScale = parameters->relativeWidth;
+        result->heightScale = parameters->relativeHeight;
+        result->image.mipCount = MAX(parameters->mipCount, 1);
+        result->layerCount = MAX(parameters->layerCount, 1);
+        ASSERT(result->image.mipCount <= RENDER_GRAPH_MAX_MIP_COUNT);
+        ASSERT(result->layerCount <= RENDER_GRAPH_MAX_LAYER_COUNT);
+        ASSERT((MAX(width, height) >> (result->image.mipCount - 1)) > 0); // More mips than the extent allows
         result->usage |= usage;
         result->format = format;
         result->image.samples = parameters->sampleCount ? parameters->sampleCount : VK_SAMPLE_COUNT_1_BIT;
         result->clearColor = parameters->clearValue;
         result->requiresClear = false; // This is set elsewhere
-        builder->imageSentinel.next = result;
         pass->outputs[pass->outputCount].layout = layout;
         pass->outputs[pass->outputCount].access = access;
         pass->outputs[pass->outputCount].stage = stage;
         pass->outputs[pass->outputCount].usage = usage;
         pass->outputs[pass->outputCount].requiresClear = parameters->clear;
-        pass->outputs[pass->outputCount++].imageHandle = outputHandle;   
+        pass->outputs[pass->outputCount].imageHandle = outputHandle;
+        if(pass->type == RENDER_GRAPH_PASS_TYPE_GRAPHICS && result->image.mipCount > 1) {
+            // Attachments can only have a single mip. The other mips stay undefined until a pass writes them
+            pass->outputs[pass->outputCount].imageHandle.subresource = 1;
+        }
+        pass->outputCount++;
     }
 
     if(parameters->resolveMode && parameters->sampleCount > 0 && parameters->sampleCount != VK_SAMPLE_COUNT_1_BIT) {
@@ -172,7 +259,11 @@ RenderGraphImageHandle renderPassAddOutput(RenderGraphBuilder* builder, RenderGr
         if(isDepthFormat(format)) {
             usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
         }
-        outputHandle = renderPassAddOutput(builder, passHandle, width, height, layout, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, usage, format, 0);
+        // The resolve target follows the output size just like the multisampled image
+        struct RenderPassOutputParameters resolveParameters = {0};
+        resolveParameters.relativeWidth = parameters->relativeWidth;
+        resolveParameters.relativeHeight = parameters->relativeHeight;
+        outputHandle = renderPassAddOutput(builder, passHandle, width, height, layout, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, usage, format, &resolveParameters);
         pass->outputs[pass->outputCount - 2].resolve = outputHandle;
         pass->outputs[pass->outputCount - 2].resolveMode = parameters->resolveMode;
         pass->outputs[pass->outputCount - 1].resolveTarget = true;
@@ -192,7 +283,7 @@ RenderGraphImageHandle renderPassAddInput(RenderGraphBuilder* builder, RenderGra
     //TODO: Why outdated???
     //(outdated) As we have possibly changed layout etc. we mark ourselves as producer as otherwise the barriers could be in the wrong order and therefore do wrong layout transitions
     pass->inputs[pass->inputCount].producer = input->producer;
-    pass->inputs[pass->inputCount].lastReader = pass;
+    pass->inputs[pass->inputCount].lastReader = passHandle;
     
     pass->inputs[pass->inputCount++].imageHandle = inputHandle;
 
@@ -203,7 +294,8 @@ RenderGraphImageHandle renderPassAddInput(RenderGraphBuilder* builder, RenderGra
 RenderGraphImageHandle renderPassAddInputOutput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, RenderGraphImageHandle inputHandle, VkImageLayout layout, VkAccessFlags access, VkPipelineStageFlags2 stage, VkImageUsageFlags usage, VkResolveModeFlags resolve) {
     struct RenderGraphBuildPass* pass = getPassFromHandle(builder, passHandle);
     struct RenderGraphBuildImage* input = getImageFromHandle(builder, inputHandle);
-    if(!input->producer) {
+    if(!input->producer.handle) {
+        ASSERT(!getImageSubresourceData(inputHandle)); // Subresources can only be selected of images that have been written
         if(input->requiresClear) {
             if(pass->type != RENDER_GRAPH_PASS_TYPE_GRAPHICS) {
                 usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
@@ -214,6 +306,10 @@ RenderGraphImageHandle renderPassAddInputOutput(RenderGraphBuilder* builder, Ren
             .clear = input->requiresClear,
             .clearValue = input->clearColor,
             .resolveMode = resolve,
+            .relativeWidth = input->widthScale,
+            .relativeHeight = input->heightScale,
+            .mipCount = input->image.mipCount,
+            .layerCount = input->layerCount,
         });
     }
 
@@ -227,10 +323,10 @@ RenderGraphImageHandle renderPassAddInputOutput(RenderGraphBuilder* builder, Ren
     pass->inputs[pass->inputCount].stage = stage;
     pass->inputs[pass->inputCount].usage = usage;
     pass->inputs[pass->inputCount].producer = input->producer;
-    //pass->inputs[pass->inputCount].lastReader = pass; // while not hurting this should not be necessary as we are producing an output
+    //pass->inputs[pass->inputCount].lastReader = passHandle; // while not hurting this should not be necessary as we are producing an output
     pass->inputs[pass->inputCount++].imageHandle = inputHandle;
 
-    input->producer = pass;
+    input->producer = passHandle;
     pass->outputs[pass->outputCount].layout = layout;
     pass->outputs[pass->outputCount].access = access;
     pass->outputs[pass->outputCount].stage = stage;
@@ -247,6 +343,54 @@ void renderPassSetExternal(RenderGraphBuilder* builder, RenderGraphPassHandle pa
     }
 }
 
+void renderPassSetAsync(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, bool async) {
+    struct RenderGraphBuildPass* pass = getPassFromHandle(builder, passHandle);
+    if(pass) {
+        ASSERT(!async || pass->type == RENDER_GRAPH_PASS_TYPE_COMPUTE); // Only compute passes can run on the compute queue
+        pass->async = async;
+    }
+}
+
+void renderPassSetStatic(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, bool isStatic) {
+    struct RenderGraphBuildPass* pass = getPassFromHandle(builder, passHandle);
+    if(pass) {
+        ASSERT(!isStatic || !pass->readback); // Readback passes copy into a different buffer every execution
+        ASSERT(!isStatic || !pass->secondaryCommandBufferCount); // Secondary command buffers are recorded every execution
+        pass->staticPass = isStatic;
+    }
+}
+
+void renderPassSetSecondaryCommandBufferCount(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, u32 count) {
+    struct RenderGraphBuildPass* pass = getPassFromHandle(builder, passHandle);
+    if(pass) {
+        ASSERT(!count || pass->type == RENDER_GRAPH_PASS_TYPE_GRAPHICS); // Only rendering can continue in secondary command buffers
+        ASSERT(!count || !pass->staticPass);
+        pass->secondaryCommandBufferCount = count;
+    }
+}
+
+void renderPassSetViewMask(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, u32 viewMask) {
+    struct RenderGraphBuildPass* pass = getPassFromHandle(builder, passHandle);
+    if(pass) {
+        ASSERT(!viewMask || pass->type == RENDER_GRAPH_PASS_TYPE_GRAPHICS); // Multiview only applies to rendering
+        pass->viewMask = viewMask;
+    }
+}
+
+void renderGraphSetScheduleMode(RenderGraphBuilder* builder, enum RenderGraphScheduleMode mode) {
+    builder->scheduleMode = mode;
+}
+
+void renderGraphSetPassBatching(RenderGraphBuilder* builder, bool batch) {
+    builder->batchPasses = batch;
+}
+
+void renderGraphSetOutputSize(RenderGraphBuilder* builder, u32 width, u32 height) {
+    ASSERT(width && height);
+    builder->outputWidth = width;
+    builder->outputHeight = height;
+}
+
 VkFormat renderGraphImageGetFormat(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle) {
     VkFormat result = VK_FORMAT_UNDEFINED;
     struct RenderGraphBuildImage* image = getImageFromHandle(builder, imageHandle);
@@ -283,6 +427,39 @@ VkSampleCountFlags renderGraphImageGetSampleCount(RenderGraphBuilder* builder, R
     return result;
 }
 
+u32 renderGraphImageGetMipCount(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle) {
+    u32 result = 1;
+    struct RenderGraphBuildImage* image = getImageFromHandle(builder, imageHandle);
+    if(image) {
+        result = image->image.mipCount;
+    }
+    return result;
+}
+
+u32 renderGraphImageGetLayerCount(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle) {
+    u32 result = 1;
+    struct RenderGraphBuildImage* image = getImageFromHandle(builder, imageHandle);
+    if(image) {
+        result = image->layerCount;
+    }
+    return result;
+}
+
+RenderGraphImageHandle renderGraphImageGetSubresource(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle, u32 mipLevel, u32 arrayLayer) {
+    struct RenderGraphBuildImage* image = getImageFromHandle(builder, imageHandle);
+    ASSERT(mipLevel == RENDER_GRAPH_ALL_MIPS || mipLevel < image->image.mipCount);
+    ASSERT(arrayLayer == RENDER_GRAPH_ALL_LAYERS || arrayLayer < image->layerCount);
+    RenderGraphImageHandle result = {0};
+    result.handle = getImageHandleData(imageHandle) | (builder->fingerprint << FINGERPRINT_SHIFT);
+    if(mipLevel != RENDER_GRAPH_ALL_MIPS) {
+        result.subresource |= mipLevel + 1;
+    }
+    if(arrayLayer != RENDER_GRAPH_ALL_LAYERS) {
+        result.subresource |= (arrayLayer + 1) << IMAGE_LAYER_SHIFT;
+    }
+    return result;
+}
+
 RenderGraphImageHandle renderGraphImageResolve(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle) {
     struct RenderGraphBuildImage* image = getImageFromHandle(builder, imageHandle);
     if(image && image->image.samples && image->image.samples != VK_SAMPLE_COUNT_1_BIT) {
@@ -290,7 +467,95 @@ RenderGraphImageHandle renderGraphImageResolve(RenderGraphBuilder* builder, Rend
         RenderGraphPassHandle resolvePass = renderGraphAddGraphicsPass(builder, STR8_LITERAL("__internal_resolve_pass"));
         //TODO: General layout is also ok. Maybe prefer this if image is already in general layout
         renderPassAddInput(builder, resolvePass, imageHandle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_2_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_2_RESOLVE_BIT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-        imageHandle = renderPassAddOutput(builder, resolvePass, image->image.width, image->image.height, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_RESOLVE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT, image->format, 0);
+        imageHandle = renderPassAddOutput(builder, resolvePass, image->image.width, image->image.height, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_RESOLVE_BIT, VK_IMAGE_USAGE_TRANSFER_DST_BIT, image->format, &(struct RenderPassOutputParameters){
+            .relativeWidth = image->widthScale,
+            .relativeHeight = image->heightScale,
+        });
     }
     return imageHandle;
 }
+
+RenderGraphBufferHandle renderGraphCreateClearedBuffer(RenderGraphBuilder* builder, u64 size, u32 clearValue) {
+    struct RenderGraphBuildBuffer* result = pushBuildBuffer(builder);
+    if(result) {
+        result->size = size;
+        result->requiresClear = true;
+        result->clearValue = clearValue;
+    }
+    return createBufferHandle(builder);
+}
+
+RenderGraphBufferHandle renderPassAddBufferOutput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, u64 size, VkAccessFlags2 access, VkPipelineStageFlags2 stage, VkBufferUsageFlags usage) {
+    struct RenderGraphBuildBuffer* result = pushBuildBuffer(builder);
+    struct RenderGraphBuildPass* pass = getPassFromHandle(builder, passHandle);
+    RenderGraphBufferHandle outputHandle = createBufferHandle(builder);
+
+    if(result) {
+        ASSERT(pass->bufferOutputCount < ARRAY_COUNT(pass->bufferOutputs));
+        result->producer = passHandle;
+        result->size = size;
+        result->usage |= usage;
+        pass->bufferOutputs[pass->bufferOutputCount].access = access;
+        pass->bufferOutputs[pass->bufferOutputCount].stage = stage;
+        pass->bufferOutputs[pass->bufferOutputCount].usage = usage;
+        pass->bufferOutputs[pass->bufferOutputCount].producer = passHandle;
+        pass->bufferOutputs[pass->bufferOutputCount++].bufferHandle = outputHandle;
+    }
+
+    return outputHandle;
+}
+
+RenderGraphBufferHandle renderPassAddBufferInput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, RenderGraphBufferHandle inputHandle, VkAccessFlags2 access, VkPipelineStageFlags2 stage, VkBufferUsageFlags usage) {
+    struct RenderGraphBuildPass* pass = getPassFromHandle(builder, passHandle);
+    struct RenderGraphBuildBuffer* input = getBufferFromHandle(builder, inputHandle);
+    // Reading a buffer that nobody has written is not supported as its content would be undefined
+    ASSERT(input->producer.handle);
+    ASSERT(pass->bufferInputCount < ARRAY_COUNT(pass->bufferInputs));
+
+    pass->bufferInputs[pass->bufferInputCount].access = access;
+    pass->bufferInputs[pass->bufferInputCount].stage = stage;
+    pass->bufferInputs[pass->bufferInputCount].usage = usage;
+    pass->bufferInputs[pass->bufferInputCount].producer = input->producer;
+    pass->bufferInputs[pass->bufferInputCount++].bufferHandle = inputHandle;
+
+    // We simply return the input handle
+    return inputHandle;
+}
+
+RenderGraphBufferHandle renderPassAddBufferInputOutput(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle, RenderGraphBufferHandle inputHandle, VkAccessFlags2 access, VkPipelineStageFlags2 stage, VkBufferUsageFlags usage) {
+    struct RenderGraphBuildPass* pass = getPassFromHandle(builder, passHandle);
+    struct RenderGraphBuildBuffer* input = getBufferFromHandle(builder, inputHandle);
+    ASSERT(pass->bufferOutputCount < ARRAY_COUNT(pass->bufferOutputs));
+
+    if(input->producer.handle) {
+        ASSERT(pass->bufferInputCount < ARRAY_COUNT(pass->bufferInputs));
+        pass->bufferInputs[pass->bufferInputCount].access = access;
+        pass->bufferInputs[pass->bufferInputCount].stage = stage;
+        pass->bufferInputs[pass->bufferInputCount].usage = usage;
+        pass->bufferInputs[pass->bufferInputCount].producer = input->producer;
+        pass->bufferInputs[pass->bufferInputCount++].bufferHandle = inputHandle;
+    } else if(input->requiresClear) {
+        // First writer of a cleared buffer. The clear is done with vkCmdFillBuffer at the start of the pass
+        input->usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        pass->bufferOutputs[pass->bufferOutputCount].requiresClear = true;
+    }
+
+    input->usage |= usage;
+    input->producer = passHandle;
+    pass->bufferOutputs[pass->bufferOutputCount].access = access;
+    pass->bufferOutputs[pass->bufferOutputCount].stage = stage;
+    pass->bufferOutputs[pass->bufferOutputCount].usage = usage;
+    pass->bufferOutputs[pass->bufferOutputCount].producer = passHandle;
+    pass->bufferOutputs[pass->bufferOutputCount++].bufferHandle = inputHandle;
+
+    return inputHandle;
+}
+
+u64 renderGraphBufferGetSize(RenderGraphBuilder* builder, RenderGraphBufferHandle bufferHandle) {
+    u64 result = 0;
+    struct RenderGraphBuildBuffer* buffer = getBufferFromHandle(builder, bufferHandle);
+    if(buffer) {
+        result = buffer->size;
+    }
+    return result;
+}
@@ -2,35 +2,34 @@
 
 #include "render_graph_definitions.inl"
 
+#include <grounded/threading/grounded_threading.h>
+
 #include <stdio.h>
 
-static inline struct RenderGraphBuildPass* getPassAtIndex(struct RenderGraphBuildPass* firstPass, u32 index) {
-    struct RenderGraphBuildPass* result = firstPass;
-    for(u32 i = 0; i < index; ++i) {
-        result = result->next;
+static enum RenderGraphQueue getPassQueue(RenderGraphBuilder* builder, struct RenderGraphBuildPass* pass) {
+    if(!pass->async || !builder->context->computeQueueCount) {
+        return RENDER_GRAPH_QUEUE_GRAPHICS;
     }
-    return result;
-}
-
-static inline u32 getIndexOfPass(struct RenderGraphBuildPass* firstPass, struct RenderGraphBuildPass* pass) {
-    u32 result = 0;
-    while(firstPass && firstPass != pass) {
-        result++;
-        firstPass = firstPass->next;
+    for(u32 i = 0; i < pass->outputCount; ++i) {
+        if(pass->outputs[i].requiresClear && isDepthFormat(getImageFromHandle(builder, pass->outputs[i].imageHandle)->format)) {
+            // vkCmdClearDepthStencilImage is not supported on compute queues
+            return RENDER_GRAPH_QUEUE_GRAPHICS;
+        }
     }
-    return result;
+    return RENDER_GRAPH_QUEUE_ASYNC_COMPUTE;
 }
 
-static void sortPasses(RenderGraphBuilder* builder, u32 passCount, RenderGraph* result) {
-    struct RenderGraphBuildPass* firstPass = builder->passSentinel.next;
+static void schedulePasses(RenderGraphBuilder* builder, RenderGraph* result, u32* sortedToBuildPass);
 
+// Runs in O(passes + attachments), plus O((passes + attachments) * log(passes)) when passes are scheduled.
+// Build passes are addressed by their index in builder->passes so no list walking is required
+static void sortPasses(RenderGraphBuilder* builder, u32 passCount, RenderGraph* result) {
     // Create graph
     for(u32 i = 0; i < passCount; ++i) {
-        struct RenderGraphBuildPass* pass = getPassAtIndex(firstPass, i);
+        struct RenderGraphBuildPass* pass = &builder->passes[i];
         for(u32 j = 0; j < pass->inputCount; ++j) {
             struct RenderGraphBuildImage* input = getImageFromHandle(builder, pass->inputs[j].imageHandle);
-            struct RenderGraphBuildPass* producer = pass->inputs[j].producer;
-            ASSERT(producer);
+            ASSERT(pass->inputs[j].producer.handle);
             input->usage |= pass->inputs[j].usage;
 
             // Create an edge between this pass and the pass that produces the input
@@ -38,6 +37,11 @@ static void sortPasses(RenderGraphBuilder* builder, u32 passCount, RenderGraph*
 
             // TODO: We could remove nodes that have no edges
         }
+        for(u32 j = 0; j < pass->bufferInputCount; ++j) {
+            struct RenderGraphBuildBuffer* input = getBufferFromHandle(builder, pass->bufferInputs[j].bufferHandle);
+            ASSERT(pass->bufferInputs[j].producer.handle);
+            input->usage |= pass->bufferInputs[j].usage;
+        }
     }
 
     // Topological sort
@@ -45,18 +49,26 @@ static void sortPasses(RenderGraphBuilder* builder, u32 passCount, RenderGraph*
     for(u32 i = 0; i < passCount; ++i) {
         result->buildPassToSortedPass[i] = UINT16_MAX;
     }
+    result->buildPassCount = passCount;
     RenderGraphPass* sortedPasses = ARENA_PUSH_ARRAY(&result->arena, passCount, RenderGraphPass);
     u32 sortedCount = 0;
 
-    // We use a non-recusive alogorithm so we need a stack
-    u32* stack = ARENA_PUSH_ARRAY(builder->arena, passCount, u32);
+    // We use a non-recusive alogorithm so we need a stack. A pass is pushed again by every consumer expanded before it,
+    // so the stack holds at most one entry per entry point and per dependency
+    u32 stackCapacity = passCount;
+    for(u32 i = 0; i < passCount; ++i) {
+        stackCapacity += builder->passes[i].inputCount + builder->passes[i].bufferInputCount;
+    }
+    u32* stack = ARENA_PUSH_ARRAY(builder->arena, stackCapacity, u32);
     u8* visited = ARENA_PUSH_ARRAY(builder->arena, passCount, u8);
+    u32* sortedToBuildPass = ARENA_PUSH_ARRAY_NO_CLEAR(builder->arena, passCount, u32);
     u32 stackSize = 0;
 
     // Do a DFS
-    //u32 i = result->swapchainOutputPassIndex;
-    for(u32 i = 0; i < passCount; ++i) {
-        if(!getPassAtIndex(firstPass, i)->external || visited[i]) {
+    // Entry points are visited from the most recently added pass to the first one
+    for(u32 entry = passCount; entry > 0; --entry) {
+        u32 i = entry - 1;
+        if(!builder->passes[i].external || visited[i]) {
             // No entrypoint as not external or already visited
             continue;
         }
@@ -64,7 +76,7 @@ static void sortPasses(RenderGraphBuilder* builder, u32 passCount, RenderGraph*
         stack[stackSize++] = i;
         visited[i] = 1;
         while(stackSize > 0) {
-            ASSERT(stackSize <= passCount);
+            ASSERT(stackSize <= stackCapacity);
             u32 passIndex = stack[stackSize-1];
             if(visited[passIndex] == 3) {
                 // Pop
@@ -73,73 +85,381 @@ static void sortPasses(RenderGraphBuilder* builder, u32 passCount, RenderGraph*
             }
             if(visited[passIndex] == 2) {
                 visited[passIndex] = 3;
-                struct RenderGraphBuildPass* buildPass = getPassAtIndex(firstPass, passIndex);
+                struct RenderGraphBuildPass* buildPass = &builder->passes[passIndex];
                 sortedPasses[sortedCount].name = str8Copy(&result->arena, buildPass->name);
                 sortedPasses[sortedCount].type = buildPass->type;
+                sortedPasses[sortedCount].queue = getPassQueue(builder, buildPass);
+                sortedPasses[sortedCount].staticPass = buildPass->staticPass;
+                sortedPasses[sortedCount].secondaryCommandBufferCount = buildPass->secondaryCommandBufferCount;
+                sortedPasses[sortedCount].secondaryCommandBuffers = ARENA_PUSH_ARRAY(&result->arena, buildPass->secondaryCommandBufferCount, VkCommandBuffer);
+                sortedPasses[sortedCount].viewMask = buildPass->viewMask;
                 sortedPasses[sortedCount].inputCount = buildPass->inputCount;
                 sortedPasses[sortedCount].outputCount = buildPass->outputCount;
                 memcpy(sortedPasses[sortedCount].inputs, buildPass->inputs, sizeof(struct RenderAttachment) * ARRAY_COUNT(buildPass->inputs));
                 memcpy(sortedPasses[sortedCount].outputs, buildPass->outputs, sizeof(struct RenderAttachment) * ARRAY_COUNT(buildPass->outputs));
-                result->buildPassToSortedPass[passCount - passIndex - 1] = sortedCount++;
+                sortedPasses[sortedCount].bufferInputCount = buildPass->bufferInputCount;
+                sortedPasses[sortedCount].bufferOutputCount = buildPass->bufferOutputCount;
+                MEMORY_COPY(sortedPasses[sortedCount].bufferInputs, buildPass->bufferInputs, sizeof(struct RenderBufferAttachment) * ARRAY_COUNT(buildPass->bufferInputs));
+                MEMORY_COPY(sortedPasses[sortedCount].bufferOutputs, buildPass->bufferOutputs, sizeof(struct RenderBufferAttachment) * ARRAY_COUNT(buildPass->bufferOutputs));
+                sortedToBuildPass[sortedCount] = passIndex;
+                result->buildPassToSortedPass[passIndex] = sortedCount++;
                 // Pop
                 stackSize--;
                 continue;
             }
             // First visit
             visited[passIndex] = 2;
-            struct RenderGraphBuildPass* pass = getPassAtIndex(firstPass, passIndex);
-            if(pass->inputCount == 0) {
+            struct RenderGraphBuildPass* pass = &builder->passes[passIndex];
+            if(pass->inputCount == 0 && pass->bufferInputCount == 0) {
                 // Leaf node
                 continue;
             }
             // Iterate through all edges and add them to the stack
-            // Edges are basically inputs->producer
+            // Edges are basically inputs->producer. A producer that is already on the stack but was not expanded yet lies below this pass
+            // and would be sorted after it, so it is pushed again
             for(u32 j = 0; j < pass->inputCount; ++j) {
-                struct RenderGraphBuildImage* input = getImageFromHandle(builder, pass->inputs[j].imageHandle);
-                struct RenderGraphBuildPass* producer = pass->inputs[j].producer;
-                ASSERT(producer);
-                struct RenderGraphBuildPass* child = producer;
-                u32 childIndex = getIndexOfPass(firstPass, child);
+                RenderGraphPassHandle producer = pass->inputs[j].producer;
+                ASSERT(producer.handle);
+                u32 childIndex = getPassIndex(producer);
                 ASSERT(childIndex < passCount);
-                if(!visited[childIndex]) {
+                ASSERT(visited[childIndex] != 2); // Cycle
+                if(visited[childIndex] < 2) {
+                    // Push
+                    stack[stackSize++] = childIndex;
+                    visited[childIndex] = 1;
+                }
+            }
+            // Buffer dependencies are edges just like image dependencies. Producers of unused buffers are never reached and therefore culled
+            for(u32 j = 0; j < pass->bufferInputCount; ++j) {
+                RenderGraphPassHandle producer = pass->bufferInputs[j].producer;
+                ASSERT(producer.handle);
+                u32 childIndex = getPassIndex(producer);
+                ASSERT(childIndex < passCount);
+                ASSERT(visited[childIndex] != 2); // Cycle
+                if(visited[childIndex] < 2) {
                     // Push
                     stack[stackSize++] = childIndex;
                     visited[childIndex] = 1;
                 }
-                /*struct RenderGraphBuildPass* lastReader = pass->inputs[j].lastReader;
-                if(lastReader) {
-                    u32 childIndex = getIndexOfPass(firstPass, lastReader);
-                    ASSERT(childIndex < passCount);
-                    if(!visited[childIndex]) {
-                        // Push
-                        stack[stackSize++] = childIndex;
-                        visited[childIndex] = 1;
-                    }
-                }*/
             }
         }
     }
     ASSERT(sortedCount <= passCount);
 
-    // SortedPasses is acually in reverse order so reverse it...
-    /*for(u32 i = 0; i < sortedCount / 2; ++i) {
-        RenderGraphPass* tmp = sortedPasses[i];
-        sortedPasses[i] = sortedPasses[sortedCount - i - 1];
-        sortedPasses[sortedCount - i - 1] = tmp;
-    }*/
-
     for(u32 i = 0; i < sortedCount; ++i) {
         sortedPasses[i].graph = result;
-        for(u32 j = 0; j < sortedPasses[i].outputCount; ++j) {
-            //struct RenderGraphBuildImage* output = getImageFromHandle(builder, sortedPasses[i].outputs[j].imageHandle);
-            //output->producer = &sortedPasses[i];
-        }
     }
     result->sortedPasses = sortedPasses;
     result->passCount = sortedCount;
+
+    if(builder->scheduleMode != RENDER_GRAPH_SCHEDULE_NONE) {
+        schedulePasses(builder, result, sortedToBuildPass);
+    }
 }
 
-StromboliImage renderGraphAllocateFramebuffer(RenderGraph* graph, StromboliContext* context, u32 width, u32 height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlags samples) {
+struct RenderGraphScheduleNode {
+    struct RenderGraphScheduleNode* next;
+    u32 pass;
+};
+
+// Adds a dependency so that to is scheduled after from
+static void addScheduleEdge(MemoryArena* scratch, struct RenderGraphScheduleNode** successors, u32* predecessorCounts, u32 from, u32 to) {
+    if(from == UINT32_MAX || from == to) {
+        return;
+    }
+    struct RenderGraphScheduleNode* edge = ARENA_PUSH_STRUCT(scratch, struct RenderGraphScheduleNode);
+    edge->pass = to;
+    edge->next = successors[from];
+    successors[from] = edge;
+    predecessorCounts[to]++;
+}
+
+// Access of a pass to a resource in topological order. Writes must stay behind every earlier access and reads behind the last write
+static void addResourceAccess(MemoryArena* scratch, struct RenderGraphScheduleNode** successors, u32* predecessorCounts, u32* lastWriter, struct RenderGraphScheduleNode** readers, u32 pass, bool write) {
+    addScheduleEdge(scratch, successors, predecessorCounts, *lastWriter, pass);
+    if(write) {
+        for(struct RenderGraphScheduleNode* reader = *readers; reader; reader = reader->next) {
+            addScheduleEdge(scratch, successors, predecessorCounts, reader->pass, pass);
+        }
+        *readers = 0;
+        *lastWriter = pass;
+    } else {
+        struct RenderGraphScheduleNode* reader = ARENA_PUSH_STRUCT(scratch, struct RenderGraphScheduleNode);
+        reader->pass = pass;
+        reader->next = *readers;
+        *readers = reader;
+    }
+}
+
+// Change in the number of alive images when pass is scheduled next
+static s32 getScheduleMemoryDelta(RenderGraphPass* pass, bool* startedImages, u32* remainingImageAccesses) {
+    s32 result = 0;
+    for(u32 i = 0; i < pass->inputCount + pass->outputCount; ++i) {
+        struct RenderAttachment* attachment = i < pass->inputCount ? &pass->inputs[i] : &pass->outputs[i - pass->inputCount];
+        u32 imageIndex = getImageHandleData(attachment->imageHandle);
+        u32 accessCount = 0;
+        bool counted = false;
+        for(u32 j = 0; j < pass->inputCount + pass->outputCount; ++j) {
+            struct RenderAttachment* other = j < pass->inputCount ? &pass->inputs[j] : &pass->outputs[j - pass->inputCount];
+            if(getImageHandleData(other->imageHandle) == imageIndex) {
+                counted |= j < i;
+                accessCount++;
+            }
+        }
+        if(counted) {
+            continue;
+        }
+        if(!startedImages[imageIndex]) {
+            result++;
+        }
+        if(remainingImageAccesses[imageIndex] == accessCount) {
+            result--;
+        }
+    }
+    return result;
+}
+
+// Ready passes of the list scheduler in a binary min heap. Keys hold the score in the upper and the pass index in the lower 32 bits,
+// so ties keep the topological order
+struct RenderGraphReadyHeap {
+    u32* passes;
+    u32* positions; // Heap position per pass. UINT32_MAX if the pass is not ready
+    u64* keys; // Per pass
+    u32 count;
+};
+
+static void swapReadyPasses(struct RenderGraphReadyHeap* heap, u32 a, u32 b) {
+    u32 pass = heap->passes[a];
+    heap->passes[a] = heap->passes[b];
+    heap->passes[b] = pass;
+    heap->positions[heap->passes[a]] = a;
+    heap->positions[heap->passes[b]] = b;
+}
+
+static void siftReadyPass(struct RenderGraphReadyHeap* heap, u32 position) {
+    while(position > 0 && heap->keys[heap->passes[position]] < heap->keys[heap->passes[(position-1) / 2]]) {
+        swapReadyPasses(heap, position, (position-1) / 2);
+        position = (position-1) / 2;
+    }
+    while(true) {
+        u32 smallest = position;
+        for(u32 child = 2 * position + 1; child <= 2 * position + 2 && child < heap->count; ++child) {
+            if(heap->keys[heap->passes[child]] < heap->keys[heap->passes[smallest]]) {
+                smallest = child;
+            }
+        }
+        if(smallest == position) {
+            break;
+        }
+        swapReadyPasses(heap, position, smallest);
+        position = smallest;
+    }
+}
+
+static void pushReadyPass(struct RenderGraphReadyHeap* heap, u32 pass, u64 score) {
+    heap->keys[pass] = (score << 32) | pass;
+    heap->passes[heap->count] = pass;
+    heap->positions[pass] = heap->count++;
+    siftReadyPass(heap, heap->count - 1);
+}
+
+static u32 popReadyPass(struct RenderGraphReadyHeap* heap) {
+    ASSERT(heap->count > 0);
+    u32 pass = heap->passes[0];
+    swapReadyPasses(heap, 0, --heap->count);
+    heap->positions[pass] = UINT32_MAX;
+    siftReadyPass(heap, 0);
+    return pass;
+}
+
+// Memory deltas are at most the attachment count of a pass. Biased so the score is never negative
+static u64 getScheduleMemoryScore(RenderGraphPass* pass, bool* startedImages, u32* remainingImageAccesses) {
+    return (u64)(getScheduleMemoryDelta(pass, startedImages, remainingImageAccesses) + (s32)(ARRAY_COUNT(pass->inputs) + ARRAY_COUNT(pass->outputs)));
+}
+
+// Reorders independent passes of the topological order. Dependencies are the producer edges of the sort
+// plus the order of accesses to each resource, so every pass sees the same resource contents as before.
+// RENDER_GRAPH_SCHEDULE_OVERLAP picks the ready pass whose latest dependency was scheduled first so barriers have more work in between.
+// RENDER_GRAPH_SCHEDULE_MEMORY picks the ready pass that keeps the fewest images alive so more memory can be aliased.
+// Ties keep the topological order. Ready passes are kept in a heap whose keys are only updated when they can change,
+// so this runs in O((passes + attachments) * log(passes))
+static void schedulePasses(RenderGraphBuilder* builder, RenderGraph* result, u32* sortedToBuildPass) {
+    MemoryArena* scratch = builder->arena;
+    u32 passCount = result->passCount;
+    u32 imageCount = builder->currentResourceIndex;
+    struct RenderGraphScheduleNode** successors = ARENA_PUSH_ARRAY(scratch, passCount, struct RenderGraphScheduleNode*);
+    u32* predecessorCounts = ARENA_PUSH_ARRAY(scratch, passCount, u32);
+    u32* lastImageWriters = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u32);
+    struct RenderGraphScheduleNode** imageReaders = ARENA_PUSH_ARRAY(scratch, imageCount, struct RenderGraphScheduleNode*);
+    u32* remainingImageAccesses = ARENA_PUSH_ARRAY(scratch, imageCount, u32);
+    bool* startedImages = ARENA_PUSH_ARRAY(scratch, imageCount, bool);
+    u32* lastBufferWriters = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, builder->currentBufferIndex, u32);
+    struct RenderGraphScheduleNode** bufferReaders = ARENA_PUSH_ARRAY(scratch, builder->currentBufferIndex, struct RenderGraphScheduleNode*);
+    for(u32 i = 0; i < imageCount; ++i) {
+        lastImageWriters[i] = UINT32_MAX;
+    }
+    for(u32 i = 0; i < builder->currentBufferIndex; ++i) {
+        lastBufferWriters[i] = UINT32_MAX;
+    }
+
+    for(u32 passIndex = 0; passIndex < passCount; ++passIndex) {
+        RenderGraphPass* pass = &result->sortedPasses[passIndex];
+        for(u32 i = 0; i < pass->inputCount; ++i) {
+            u32 imageIndex = getImageHandleData(pass->inputs[i].imageHandle);
+            bool write = false;
+            for(u32 j = 0; j < pass->outputCount; ++j) {
+                write |= imageHandlesOverlap(pass->outputs[j].imageHandle, pass->inputs[i].imageHandle);
+            }
+            addResourceAccess(scratch, successors, predecessorCounts, &lastImageWriters[imageIndex], &imageReaders[imageIndex], passIndex, write);
+            remainingImageAccesses[imageIndex]++;
+        }
+        for(u32 i = 0; i < pass->outputCount; ++i) {
+            u32 imageIndex = getImageHandleData(pass->outputs[i].imageHandle);
+            addResourceAccess(scratch, successors, predecessorCounts, &lastImageWriters[imageIndex], &imageReaders[imageIndex], passIndex, true);
+            remainingImageAccesses[imageIndex]++;
+        }
+        for(u32 i = 0; i < pass->bufferInputCount; ++i) {
+            u32 bufferIndex = getBufferHandleData(pass->bufferInputs[i].bufferHandle);
+            bool write = false;
+            for(u32 j = 0; j < pass->bufferOutputCount; ++j) {
+                write |= pass->bufferOutputs[j].bufferHandle.handle == pass->bufferInputs[i].bufferHandle.handle;
+            }
+            addResourceAccess(scratch, successors, predecessorCounts, &lastBufferWriters[bufferIndex], &bufferReaders[bufferIndex], passIndex, write);
+        }
+        for(u32 i = 0; i < pass->bufferOutputCount; ++i) {
+            u32 bufferIndex = getBufferHandleData(pass->bufferOutputs[i].bufferHandle);
+            addResourceAccess(scratch, successors, predecessorCounts, &lastBufferWriters[bufferIndex], &bufferReaders[bufferIndex], passIndex, true);
+        }
+    }
+
+    // The memory score of a pass only changes when one of its images starts or when an image gets close enough to its last access.
+    // The passes accessing an image are needed to update their scores then. Stored contiguously per image
+    bool memoryMode = builder->scheduleMode == RENDER_GRAPH_SCHEDULE_MEMORY;
+    u32* imageAccessStarts = 0;
+    u32* imageAccessPasses = 0;
+    if(memoryMode) {
+        imageAccessStarts = ARENA_PUSH_ARRAY(scratch, imageCount + 1, u32);
+        for(u32 i = 0; i < imageCount; ++i) {
+            imageAccessStarts[i+1] = imageAccessStarts[i] + remainingImageAccesses[i];
+        }
+        imageAccessPasses = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageAccessStarts[imageCount], u32);
+        u32* fillCounts = ARENA_PUSH_ARRAY(scratch, imageCount, u32);
+        for(u32 passIndex = 0; passIndex < passCount; ++passIndex) {
+            RenderGraphPass* pass = &result->sortedPasses[passIndex];
+            for(u32 i = 0; i < pass->inputCount + pass->outputCount; ++i) {
+                struct RenderAttachment* attachment = i < pass->inputCount ? &pass->inputs[i] : &pass->outputs[i - pass->inputCount];
+                u32 imageIndex = getImageHandleData(attachment->imageHandle);
+                imageAccessPasses[imageAccessStarts[imageIndex] + fillCounts[imageIndex]++] = passIndex;
+            }
+        }
+    }
+
+    // List scheduling. Ready passes have all their dependencies scheduled
+    u32* order = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, passCount, u32);
+    struct RenderGraphReadyHeap heap = {0};
+    heap.passes = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, passCount, u32);
+    heap.positions = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, passCount, u32);
+    heap.keys = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, passCount, u64);
+    for(u32 passIndex = 0; passIndex < passCount; ++passIndex) {
+        heap.positions[passIndex] = UINT32_MAX;
+        if(!predecessorCounts[passIndex]) {
+            u64 score = memoryMode ? getScheduleMemoryScore(&result->sortedPasses[passIndex], startedImages, remainingImageAccesses) : 0;
+            pushReadyPass(&heap, passIndex, score);
+        }
+    }
+    for(u32 position = 0; position < passCount; ++position) {
+        u32 passIndex = popReadyPass(&heap);
+        order[position] = passIndex;
+
+        RenderGraphPass* pass = &result->sortedPasses[passIndex];
+        u32 attachmentCount = pass->inputCount + pass->outputCount;
+        bool startedBefore[ARRAY_COUNT(pass->inputs) + ARRAY_COUNT(pass->outputs)];
+        for(u32 i = 0; i < attachmentCount; ++i) {
+            struct RenderAttachment* attachment = i < pass->inputCount ? &pass->inputs[i] : &pass->outputs[i - pass->inputCount];
+            u32 imageIndex = getImageHandleData(attachment->imageHandle);
+            startedBefore[i] = startedImages[imageIndex];
+            startedImages[imageIndex] = true;
+            remainingImageAccesses[imageIndex]--;
+        }
+        if(memoryMode) {
+            for(u32 i = 0; i < attachmentCount; ++i) {
+                struct RenderAttachment* attachment = i < pass->inputCount ? &pass->inputs[i] : &pass->outputs[i - pass->inputCount];
+                u32 imageIndex = getImageHandleData(attachment->imageHandle);
+                // A pass never accesses an image more often than it has attachments, so only then a pass can become its last access
+                bool lastAccessReachable = remainingImageAccesses[imageIndex] <= ARRAY_COUNT(pass->inputs) + ARRAY_COUNT(pass->outputs);
+                if(startedBefore[i] && !lastAccessReachable) {
+                    continue;
+                }
+                for(u32 j = imageAccessStarts[imageIndex]; j < imageAccessStarts[imageIndex+1]; ++j) {
+                    u32 other = imageAccessPasses[j];
+                    if(heap.positions[other] != UINT32_MAX) {
+                        heap.keys[other] = (getScheduleMemoryScore(&result->sortedPasses[other], startedImages, remainingImageAccesses) << 32) | other;
+                        siftReadyPass(&heap, heap.positions[other]);
+                    }
+                }
+            }
+        }
+        for(struct RenderGraphScheduleNode* edge = successors[passIndex]; edge; edge = edge->next) {
+            if(--predecessorCounts[edge->pass] == 0) {
+                // The pass scheduled last is its latest dependency. Positions start at 1 so passes without dependencies are preferred
+                u64 score = memoryMode ? getScheduleMemoryScore(&result->sortedPasses[edge->pass], startedImages, remainingImageAccesses) : position + 1;
+                pushReadyPass(&heap, edge->pass, score);
+            }
+        }
+    }
+
+    // Apply the new order
+    RenderGraphPass* topologicalPasses = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, passCount, RenderGraphPass);
+    u32* topologicalToBuildPass = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, passCount, u32);
+    MEMORY_COPY(topologicalPasses, result->sortedPasses, sizeof(RenderGraphPass) * passCount);
+    MEMORY_COPY(topologicalToBuildPass, sortedToBuildPass, sizeof(u32) * passCount);
+    for(u32 position = 0; position < passCount; ++position) {
+        result->sortedPasses[position] = topologicalPasses[order[position]];
+        sortedToBuildPass[position] = topologicalToBuildPass[order[position]];
+        result->buildPassToSortedPass[sortedToBuildPass[position]] = (u16)position;
+    }
+}
+
+// Suballocates device local memory from the graph memory blocks. Allocates a new block if no existing one has enough space left
+static struct RenderGraphMemoryBlock* renderGraphAllocateMemory(RenderGraph* graph, StromboliContext* context, VkMemoryRequirements memoryRequirements, u64* outOffset) {
+    // Check if we have an available block. Otherwise allocate a new one!
+    struct RenderGraphMemoryBlock* memoryBlock = graph->firstBlock;
+    struct RenderGraphMemoryBlock** nextPointerLocation = &graph->firstBlock;
+    u32 memoryTypeIndex = stromboliFindMemoryType(context, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    while(memoryBlock) {
+        if(memoryBlock->type == memoryTypeIndex) {
+            u64 memoryOffset = ALIGN_UP_POW2(memoryBlock->offset, memoryRequirements.alignment);
+            if(memoryOffset + memoryRequirements.size <= memoryBlock->size) {
+                // Enough space left
+                break;
+            }
+        }
+        nextPointerLocation = &memoryBlock->next;
+        memoryBlock = memoryBlock->next;
+    }
+    if(!memoryBlock) {
+        // Need to allocate a new memory block
+        printf("Allocating new memory block for render graph resources\n");
+        ASSERT(*nextPointerLocation == 0);
+        VkMemoryAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+        allocateInfo.allocationSize = MAX(memoryRequirements.size, MB(256));
+        allocateInfo.memoryTypeIndex = memoryTypeIndex;
+        memoryBlock = ARENA_PUSH_STRUCT(&graph->arena, struct RenderGraphMemoryBlock);
+        vkAllocateMemory(context->device, &allocateInfo, 0, &memoryBlock->memory);
+        memoryBlock->size = allocateInfo.allocationSize;
+        memoryBlock->offset = 0;
+        memoryBlock->type = memoryTypeIndex;
+        // Add to blocks
+        *nextPointerLocation = memoryBlock;
+    }
+    u64 memoryOffset = ALIGN_UP_POW2(memoryBlock->offset, memoryRequirements.alignment);
+    memoryBlock->offset = memoryOffset + memoryRequirements.size;
+    *outOffset = memoryOffset;
+    return memoryBlock;
+}
+
+// Creates the image without binding any memory so the memory can be placed based on image lifetimes
+static StromboliImage renderGraphCreateFramebuffer(StromboliContext* context, u32 width, u32 height, VkFormat format, VkImageUsageFlags usage, VkSampleCountFlags samples, u32 mipCount, u32 layerCount, VkMemoryRequirements* outMemoryRequirements) {
     StromboliImage result = {0};
 
     {
@@ -148,8 +468,8 @@ StromboliImage renderGraphAllocateFramebuffer(RenderGraph* graph, StromboliConte
 		createInfo.extent.width = width;
 		createInfo.extent.height = height;
 		createInfo.extent.depth = 1;
-		createInfo.mipLevels = 1;
-		createInfo.arrayLayers = 1;
+		createInfo.mipLevels = mipCount;
+		createInfo.arrayLayers = layerCount;
 		createInfo.format = format;
 		createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -172,104 +492,1668 @@ StromboliImage renderGraphAllocateFramebuffer(RenderGraph* graph, StromboliConte
     } else {
         vkGetImageMemoryRequirements(context->device, result.image, &memoryRequirements);
     }
+    *outMemoryRequirements = memoryRequirements;
 
-    // Check if we have an available block. Otherwise allocate a new one!
-    struct RenderGraphMemoryBlock* memoryBlock = graph->firstBlock;
-    struct RenderGraphMemoryBlock** nextPointerLocation = &graph->firstBlock;
-    u32 memoryTypeIndex = stromboliFindMemoryType(context, memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    while(memoryBlock) {
-        if(memoryBlock->type == memoryTypeIndex) {
-            u64 memoryOffset = ALIGN_UP_POW2(memoryBlock->offset, memoryRequirements.alignment);
-            if(memoryOffset + memoryRequirements.size <= memoryBlock->size) {
-                // Enough space left
+	result.width = width;
+	result.height = height;
+	result.depth = 1;
+	result.mipCount = mipCount;
+	result.format = format;
+	result.samples = samples;
+	return result;
+}
+
+static VkImageView renderGraphCreateImageView(StromboliContext* context, StromboliImage* image, VkImageSubresourceRange range, bool arrayView) {
+    VkImageView result = 0;
+    VkImageViewCreateInfo createInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    createInfo.image = image->image;
+    createInfo.viewType = arrayView ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    createInfo.format = image->format;
+    createInfo.subresourceRange = range;
+    vkCreateImageView(context->device, &createInfo, 0, &result);
+    return result;
+}
+
+static void renderGraphBindFramebuffer(StromboliContext* context, StromboliImage* image, u32 layerCount, VkDeviceMemory memory, u64 memoryOffset) {
+    vkBindImageMemory(context->device, image->image, memory, memoryOffset);
+
+    // The view covers all mips and layers. Subresource views are created separately
+    RenderGraphImageHandle wholeImage = {0};
+    image->view = renderGraphCreateImageView(context, image, getImageHandleRange(wholeImage, image->format, image->mipCount, layerCount), layerCount > 1);
+}
+
+// Creates a view and size for every subresource selected by an attachment. Only the entries of images that are not fixed are recreated
+static void renderGraphCreateSubresourceViews(RenderGraph* graph, StromboliContext* context, bool* fixed) {
+    for(u32 i = 0; i < graph->subresourceCount; ++i) {
+        struct RenderGraphSubresource* subresource = &graph->subresources[i];
+        RenderGraphImageHandle handle = subresource->handle;
+        u32 imageIndex = getImageHandleData(handle);
+        if(fixed && fixed[imageIndex]) {
+            continue;
+        }
+        StromboliImage* image = &graph->images[imageIndex];
+        VkImageSubresourceRange range = getImageHandleRange(handle, image->format, image->mipCount, graph->imagePlacements[imageIndex].layerCount);
+        subresource->image = *image;
+        subresource->image.width = MAX(image->width >> range.baseMipLevel, 1);
+        subresource->image.height = MAX(image->height >> range.baseMipLevel, 1);
+        subresource->image.mipCount = range.levelCount;
+        subresource->image.view = renderGraphCreateImageView(context, image, range, range.layerCount > 1);
+    }
+}
+
+StromboliBuffer renderGraphAllocateBuffer(RenderGraph* graph, StromboliContext* context, u64 size, VkBufferUsageFlags usage) {
+    StromboliBuffer result = {0};
+
+    {
+        VkBufferCreateInfo createInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+        createInfo.size = size;
+        createInfo.usage = usage;
+        createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        vkCreateBuffer(context->device, &createInfo, 0, &result.buffer);
+    }
+
+    VkMemoryRequirements memoryRequirements = {0};
+    vkGetBufferMemoryRequirements(context->device, result.buffer, &memoryRequirements);
+    // Buffers share the memory blocks with optimal tiled images. Keep them on their own bufferImageGranularity pages
+    u64 granularity = MAX(context->physicalDeviceLimits.bufferImageGranularity, 1);
+    memoryRequirements.alignment = MAX(memoryRequirements.alignment, granularity);
+    memoryRequirements.size = ALIGN_UP_POW2(memoryRequirements.size, granularity);
+
+    u64 memoryOffset = 0;
+    struct RenderGraphMemoryBlock* memoryBlock = renderGraphAllocateMemory(graph, context, memoryRequirements, &memoryOffset);
+    vkBindBufferMemory(context->device, result.buffer, memoryBlock->memory, memoryOffset);
+
+    // Memory is owned by the memory block so result.memory stays 0
+    result.size = size;
+    return result;
+}
+
+struct RenderGraphImageLifetime {
+    u32 firstPass; // Index of the first sorted pass accessing the image. UINT32_MAX if no pass accesses the image
+    u32 lastPass; // Index of the last sorted pass accessing the image. passCount if the image is used after the graph
+    u32 firstAccessPass; // Index of the sorted pass that actually accesses the image first. firstPass is widened for async images
+    VkPipelineStageFlags2 lastStage; // Stages of all accesses in lastPass
+    VkAccessFlags2 lastAccess;
+    VkPipelineStageFlags2 aliasStage; // Accesses of images that previously occupied the same memory. The first access has to wait for them
+    VkAccessFlags2 aliasAccess;
+    VkMemoryRequirements memoryRequirements;
+    u32 memoryType;
+    u64 offset; // Offset inside the memory range shared by all images of memoryType
+    bool usedOnAsyncQueue;
+    bool aliasesPreviousExecution; // No earlier image of this execution used the memory. The alias accesses include the last accesses of the previous execution
+};
+
+static bool lifetimesOverlap(struct RenderGraphImageLifetime* a, struct RenderGraphImageLifetime* b) {
+    if(a->firstPass == UINT32_MAX || b->firstPass == UINT32_MAX) {
+        // Unused images are never accessed and can share memory with anything
+        return false;
+    }
+    return a->firstPass <= b->lastPass && b->firstPass <= a->lastPass;
+}
+
+static bool memoryRangesOverlap(struct RenderGraphImageLifetime* a, struct RenderGraphImageLifetime* b) {
+    return a->memoryType == b->memoryType && a->offset < b->offset + b->memoryRequirements.size && b->offset < a->offset + a->memoryRequirements.size;
+}
+
+// Stable merge sort of image indices by ascending keys[index]. O(n log n)
+static void sortImagesByKey(u32* order, u64* keys, u32 count, MemoryArena* scratch) {
+    u32* temp = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, count, u32);
+    for(u32 width = 1; width < count; width *= 2) {
+        for(u32 start = 0; start < count; start += 2 * width) {
+            u32 middle = MIN(start + width, count);
+            u32 end = MIN(start + 2 * width, count);
+            u32 a = start;
+            u32 b = middle;
+            u32 k = start;
+            while(a < middle && b < end) {
+                temp[k++] = keys[order[b]] < keys[order[a]] ? order[b++] : order[a++];
+            }
+            while(a < middle) {
+                temp[k++] = order[a++];
+            }
+            while(b < end) {
+                temp[k++] = order[b++];
+            }
+        }
+        MEMORY_COPY(order, temp, sizeof(u32) * count);
+    }
+}
+
+// Free memory range of one memory type while placing images
+struct RenderGraphFreeRange {
+    u32 next; // UINT32_MAX at the end of the list
+    u32 prev; // UINT32_MAX at the start of the list
+    u64 offset;
+    u64 end; // UINT64_MAX for the unbounded range at the end of a memory type
+    VkPipelineStageFlags2 stage; // Last accesses of the images that occupied the range before. Images placed into it have to wait for them
+    VkAccessFlags2 access;
+    bool reserved; // Memory of fixed images. Other images are never placed into it so fixed images always find their range free
+    bool initial; // Not used by any image of this execution yet. Only the previous execution accessed it
+};
+
+// Free ranges of every memory type sorted by offset. Nodes of removed ranges are recycled
+struct RenderGraphFreeList {
+    struct RenderGraphFreeRange* ranges;
+    u32 capacity;
+    u32 count;
+    u32 firstUnused; // Recycled nodes linked by next
+    u32 heads[VK_MAX_MEMORY_TYPES];
+};
+
+static u32 insertFreeRange(struct RenderGraphFreeList* list, u32 type, u32 prev, u64 offset, u64 end, VkPipelineStageFlags2 stage, VkAccessFlags2 access, bool reserved, bool initial) {
+    u32 index = list->firstUnused;
+    if(index != UINT32_MAX) {
+        list->firstUnused = list->ranges[index].next;
+    } else {
+        ASSERT(list->count < list->capacity);
+        index = list->count++;
+    }
+    u32 next = (prev == UINT32_MAX) ? list->heads[type] : list->ranges[prev].next;
+    list->ranges[index] = (struct RenderGraphFreeRange){.next = next, .prev = prev, .offset = offset, .end = end, .stage = stage, .access = access, .reserved = reserved, .initial = initial};
+    if(prev == UINT32_MAX) {
+        list->heads[type] = index;
+    } else {
+        list->ranges[prev].next = index;
+    }
+    if(next != UINT32_MAX) {
+        list->ranges[next].prev = index;
+    }
+    return index;
+}
+
+static void removeFreeRange(struct RenderGraphFreeList* list, u32 type, u32 index) {
+    struct RenderGraphFreeRange* range = &list->ranges[index];
+    if(range->prev == UINT32_MAX) {
+        list->heads[type] = range->next;
+    } else {
+        list->ranges[range->prev].next = range->next;
+    }
+    if(range->next != UINT32_MAX) {
+        list->ranges[range->next].prev = range->prev;
+    }
+    range->next = list->firstUnused;
+    list->firstUnused = index;
+}
+
+// Takes [offset, offset + size) out of a free range. The image inherits the accesses of the previous occupants
+static void takeFreeRange(struct RenderGraphFreeList* list, u32 type, u32 index, struct RenderGraphImageLifetime* lifetime) {
+    struct RenderGraphFreeRange* range = &list->ranges[index];
+    u64 end = lifetime->offset + lifetime->memoryRequirements.size;
+    ASSERT(range->offset <= lifetime->offset && end <= range->end);
+    lifetime->aliasStage = range->stage;
+    lifetime->aliasAccess = range->access;
+    lifetime->aliasesPreviousExecution = range->initial;
+    if(range->offset < lifetime->offset) {
+        insertFreeRange(list, type, range->prev, range->offset, lifetime->offset, range->stage, range->access, range->reserved, range->initial);
+        range = &list->ranges[index];
+    }
+    range->offset = end;
+    if(range->offset == range->end) {
+        removeFreeRange(list, type, index);
+    }
+}
+
+// Returns the range of an image that is no longer used. Its last accesses are all a later occupant has to wait for,
+// as they already happen after the accesses of earlier occupants
+static void releaseFreeRange(struct RenderGraphFreeList* list, u32 type, struct RenderGraphImageLifetime* lifetime, bool reserved) {
+    u64 offset = lifetime->offset;
+    u64 end = offset + lifetime->memoryRequirements.size;
+    u32 prev = UINT32_MAX;
+    for(u32 index = list->heads[type]; index != UINT32_MAX && list->ranges[index].offset < offset; index = list->ranges[index].next) {
+        prev = index;
+    }
+    u32 index = insertFreeRange(list, type, prev, offset, end, lifetime->lastStage, lifetime->lastAccess, reserved, false);
+    struct RenderGraphFreeRange* range = &list->ranges[index];
+    if(range->next != UINT32_MAX) {
+        struct RenderGraphFreeRange* next = &list->ranges[range->next];
+        if(next->offset == end && next->reserved == reserved) {
+            range->end = next->end;
+            range->stage |= next->stage;
+            range->access |= next->access;
+            range->initial |= next->initial;
+            removeFreeRange(list, type, range->next);
+        }
+    }
+    if(prev != UINT32_MAX && list->ranges[prev].end == offset && list->ranges[prev].reserved == reserved) {
+        list->ranges[prev].end = range->end;
+        list->ranges[prev].stage |= range->stage;
+        list->ranges[prev].access |= range->access;
+        list->ranges[prev].initial |= range->initial;
+        removeFreeRange(list, type, index);
+    }
+}
+
+// Places every image that does not have a fixed offset yet by sweeping over the sorted passes. Ranges of images that are no longer used
+// go back to a free list per memory type and images starting at a pass take the first free range that fits, so images whose lifetimes
+// do not overlap share memory. Also fills the alias accesses every image has to wait for before its first use.
+// Fixed images keep their offset. Their memory is reserved for fixed images during the whole graph so new images only alias with each other.
+// Runs in O(n log n + n * free ranges). Returns the memory required per memory type in requiredSizes.
+// previousStages and previousAccesses are the last accesses of the images that used each memory type before, for example those of the
+// graph this one replaces. heapStages and heapAccesses receive the ones of these images
+static void placeImages(MemoryArena* scratch, struct RenderGraphImageLifetime* lifetimes, u32 imageCount, bool* fixed, u64* requiredSizes,
+    VkPipelineStageFlags2* previousStages, VkAccessFlags2* previousAccesses, VkPipelineStageFlags2* heapStages, VkAccessFlags2* heapAccesses) {
+    u32* placeOrder = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u32);
+    u32* releaseOrder = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u32);
+    u32* reservedOrder = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u32);
+    u64* keys = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u64);
+    u32 placeCount = 0;
+    u32 reservedCount = 0;
+    for(u32 i = 0; i < imageCount; ++i) {
+        struct RenderGraphImageLifetime* lifetime = &lifetimes[i];
+        lifetime->aliasStage = 0;
+        lifetime->aliasAccess = 0;
+        if(lifetime->memoryType == UINT32_MAX) {
+            continue;
+        }
+        if(lifetime->firstPass == UINT32_MAX) {
+            // Unused images are never accessed and can share memory with anything
+            if(!fixed[i]) {
+                lifetime->offset = 0;
+            }
+            requiredSizes[lifetime->memoryType] = MAX(requiredSizes[lifetime->memoryType], lifetime->offset + lifetime->memoryRequirements.size);
+        } else {
+            placeOrder[placeCount++] = i;
+            if(fixed[i]) {
+                reservedOrder[reservedCount++] = i;
+            }
+        }
+    }
+
+    // Images starting at the same pass are placed biggest first as this keeps the memory ranges dense
+    MEMORY_COPY(releaseOrder, placeOrder, sizeof(u32) * placeCount);
+    for(u32 i = 0; i < placeCount; ++i) {
+        keys[placeOrder[i]] = UINT64_MAX - lifetimes[placeOrder[i]].memoryRequirements.size;
+    }
+    sortImagesByKey(placeOrder, keys, placeCount, scratch);
+    for(u32 i = 0; i < placeCount; ++i) {
+        keys[placeOrder[i]] = lifetimes[placeOrder[i]].firstPass;
+    }
+    sortImagesByKey(placeOrder, keys, placeCount, scratch);
+    for(u32 i = 0; i < placeCount; ++i) {
+        keys[releaseOrder[i]] = lifetimes[releaseOrder[i]].lastPass;
+    }
+    sortImagesByKey(releaseOrder, keys, placeCount, scratch);
+    for(u32 i = 0; i < reservedCount; ++i) {
+        keys[reservedOrder[i]] = lifetimes[reservedOrder[i]].offset;
+    }
+    sortImagesByKey(reservedOrder, keys, reservedCount, scratch);
+    for(u32 i = 0; i < reservedCount; ++i) {
+        keys[reservedOrder[i]] = lifetimes[reservedOrder[i]].memoryType;
+    }
+    sortImagesByKey(reservedOrder, keys, reservedCount, scratch);
+
+    // Every memory type starts with the reserved ranges of fixed images and free ranges in between.
+    // Placing an image splits at most one range and releasing adds at most one
+    struct RenderGraphFreeList list = {0};
+    list.capacity = 2 * reservedCount + 2 * placeCount + VK_MAX_MEMORY_TYPES;
+    list.ranges = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, list.capacity, struct RenderGraphFreeRange);
+    list.firstUnused = UINT32_MAX;
+    u32 tails[VK_MAX_MEMORY_TYPES];
+    u64 cursors[VK_MAX_MEMORY_TYPES] = {0};
+    for(u32 type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+        list.heads[type] = UINT32_MAX;
+        tails[type] = UINT32_MAX;
+    }
+    for(u32 i = 0; i < reservedCount; ++i) {
+        struct RenderGraphImageLifetime* lifetime = &lifetimes[reservedOrder[i]];
+        u32 type = lifetime->memoryType;
+        u64 end = lifetime->offset + lifetime->memoryRequirements.size;
+        if(tails[type] != UINT32_MAX && list.ranges[tails[type]].reserved && lifetime->offset <= list.ranges[tails[type]].end) {
+            // Fixed images with disjoint lifetimes can alias each other
+            list.ranges[tails[type]].end = MAX(list.ranges[tails[type]].end, end);
+        } else {
+            if(lifetime->offset > cursors[type]) {
+                tails[type] = insertFreeRange(&list, type, tails[type], cursors[type], lifetime->offset, 0, 0, false, true);
+            }
+            tails[type] = insertFreeRange(&list, type, tails[type], lifetime->offset, end, 0, 0, true, true);
+        }
+        cursors[type] = list.ranges[tails[type]].end;
+    }
+    for(u32 type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+        insertFreeRange(&list, type, tails[type], cursors[type], UINT64_MAX, 0, 0, false, true);
+    }
+
+    u32 releaseIndex = 0;
+    for(u32 i = 0; i < placeCount; ++i) {
+        struct RenderGraphImageLifetime* lifetime = &lifetimes[placeOrder[i]];
+        while(releaseIndex < placeCount && lifetimes[releaseOrder[releaseIndex]].lastPass < lifetime->firstPass) {
+            struct RenderGraphImageLifetime* released = &lifetimes[releaseOrder[releaseIndex]];
+            releaseFreeRange(&list, released->memoryType, released, fixed[releaseOrder[releaseIndex]]);
+            releaseIndex++;
+        }
+        u32 type = lifetime->memoryType;
+        u32 index = list.heads[type];
+        if(fixed[placeOrder[i]]) {
+            // No other image that is alive overlaps a fixed image so its range lies inside a single reserved range
+            while(index != UINT32_MAX && !(list.ranges[index].reserved && list.ranges[index].offset <= lifetime->offset && lifetime->offset < list.ranges[index].end)) {
+                index = list.ranges[index].next;
+            }
+        } else {
+            // First fit
+            for(; index != UINT32_MAX; index = list.ranges[index].next) {
+                struct RenderGraphFreeRange* range = &list.ranges[index];
+                lifetime->offset = ALIGN_UP_POW2(range->offset, lifetime->memoryRequirements.alignment);
+                if(!range->reserved && lifetime->offset + lifetime->memoryRequirements.size <= range->end) {
+                    break;
+                }
+            }
+        }
+        ASSERT(index != UINT32_MAX);
+        takeFreeRange(&list, type, index, lifetime);
+        requiredSizes[type] = MAX(requiredSizes[type], lifetime->offset + lifetime->memoryRequirements.size);
+    }
+
+    // All executions share the same memory. Images that are the first to use their memory in an execution wait for the
+    // last accesses of the previous execution. Those are not known per range so every image of the memory type counts.
+    // The previous execution might also belong to the replaced graph
+    MEMORY_CLEAR(heapStages, sizeof(VkPipelineStageFlags2) * VK_MAX_MEMORY_TYPES);
+    MEMORY_CLEAR(heapAccesses, sizeof(VkAccessFlags2) * VK_MAX_MEMORY_TYPES);
+    for(u32 i = 0; i < placeCount; ++i) {
+        struct RenderGraphImageLifetime* lifetime = &lifetimes[placeOrder[i]];
+        heapStages[lifetime->memoryType] |= lifetime->lastStage;
+        heapAccesses[lifetime->memoryType] |= lifetime->lastAccess;
+    }
+    for(u32 i = 0; i < placeCount; ++i) {
+        struct RenderGraphImageLifetime* lifetime = &lifetimes[placeOrder[i]];
+        if(lifetime->aliasesPreviousExecution) {
+            lifetime->aliasStage |= heapStages[lifetime->memoryType] | previousStages[lifetime->memoryType];
+            lifetime->aliasAccess |= heapAccesses[lifetime->memoryType] | previousAccesses[lifetime->memoryType];
+        }
+    }
+}
+
+// Counts the images sharing memory with at least one other image. In offset order an image overlaps an earlier image exactly
+// if it starts before the furthest end so far, and then it overlaps the image with that end. O(n log n)
+static u32 countAliasedImages(struct RenderGraphImageLifetime* lifetimes, u32 imageCount, MemoryArena* scratch) {
+    u32* order = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u32);
+    u64* keys = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u64);
+    bool* aliased = ARENA_PUSH_ARRAY(scratch, imageCount, bool);
+    u32 count = 0;
+    for(u32 i = 0; i < imageCount; ++i) {
+        if(lifetimes[i].firstPass != UINT32_MAX && lifetimes[i].memoryType != UINT32_MAX) {
+            order[count++] = i;
+            keys[i] = lifetimes[i].offset;
+        }
+    }
+    sortImagesByKey(order, keys, count, scratch);
+    for(u32 i = 0; i < count; ++i) {
+        keys[order[i]] = lifetimes[order[i]].memoryType;
+    }
+    sortImagesByKey(order, keys, count, scratch);
+
+    u32 aliasedImageCount = 0;
+    u32 furthest = UINT32_MAX;
+    for(u32 i = 0; i < count; ++i) {
+        struct RenderGraphImageLifetime* lifetime = &lifetimes[order[i]];
+        if(furthest != UINT32_MAX && lifetimes[furthest].memoryType == lifetime->memoryType &&
+            lifetime->offset < lifetimes[furthest].offset + lifetimes[furthest].memoryRequirements.size) {
+            aliasedImageCount += !aliased[order[i]] + !aliased[furthest];
+            aliased[order[i]] = true;
+            aliased[furthest] = true;
+        }
+        if(furthest == UINT32_MAX || lifetimes[furthest].memoryType != lifetime->memoryType ||
+            lifetime->offset + lifetime->memoryRequirements.size > lifetimes[furthest].offset + lifetimes[furthest].memoryRequirements.size) {
+            furthest = order[i];
+        }
+    }
+    return aliasedImageCount;
+}
+
+// Queues a resource that executions submitted so far might still use. It is destroyed once they have finished
+static struct RenderGraphRetiredResource* retireResource(RenderGraph* graph, enum RenderGraphRetiredType type) {
+    if(graph->retiredResourceCount == graph->retiredResourceCapacity) {
+        u32 capacity = MAX(64, graph->retiredResourceCapacity * 2);
+        struct RenderGraphRetiredResource* resources = ARENA_PUSH_ARRAY_NO_CLEAR(&graph->arena, capacity, struct RenderGraphRetiredResource);
+        MEMORY_COPY(resources, graph->retiredResources, sizeof(struct RenderGraphRetiredResource) * graph->retiredResourceCount);
+        graph->retiredResources = resources;
+        graph->retiredResourceCapacity = capacity;
+    }
+    struct RenderGraphRetiredResource* result = &graph->retiredResources[graph->retiredResourceCount++];
+    result->executionCount = graph->executionCount;
+    result->type = type;
+    return result;
+}
+
+// Destroys the retired resources whose executions have finished. Once executionCount executions were submitted, advancing the frame slot
+// has waited for the fence of execution executionCount - RENDER_GRAPH_FRAMES_IN_FLIGHT. If idle is set no execution is pending at all
+static void destroyRetiredResources(RenderGraph* graph, bool idle) {
+    StromboliContext* context = graph->context;
+    u32 destroyedCount = 0;
+    for(; destroyedCount < graph->retiredResourceCount; ++destroyedCount) {
+        struct RenderGraphRetiredResource* resource = &graph->retiredResources[destroyedCount];
+        if(!idle && resource->executionCount + RENDER_GRAPH_FRAMES_IN_FLIGHT > graph->executionCount + 1) {
+            // Resources are ordered by execution count so all following ones are still in use as well
+            break;
+        }
+        switch(resource->type) {
+            case RENDER_GRAPH_RETIRED_IMAGE:
+                stromboliImageDestroy(context, &resource->image);
+                break;
+            case RENDER_GRAPH_RETIRED_BUFFER:
+                stromboliDestroyBuffer(context, &resource->buffer);
+                break;
+            case RENDER_GRAPH_RETIRED_VIEW:
+                vkDestroyImageView(context->device, resource->view, 0);
+                break;
+            case RENDER_GRAPH_RETIRED_MEMORY:
+                vkFreeMemory(context->device, resource->memory, 0);
                 break;
+        }
+    }
+    for(u32 i = destroyedCount; i < graph->retiredResourceCount; ++i) {
+        graph->retiredResources[i - destroyedCount] = graph->retiredResources[i];
+    }
+    graph->retiredResourceCount -= destroyedCount;
+}
+
+// Transient attachments prefer lazily allocated memory. Falls back to regular device local memory that is aliased like any other image
+static u32 findImageMemoryType(StromboliContext* context, VkImageUsageFlags usage, u32 memoryTypeBits) {
+    if(usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(context->physicalDevice, &memoryProperties);
+        VkMemoryPropertyFlags lazy = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        for(u32 i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+            if((memoryTypeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & lazy) == lazy) {
+                return i;
+            }
+        }
+    }
+    return stromboliFindMemoryType(context, memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+// Places all images and binds the ones that are not fixed to the image heaps. Fixed images keep their memory placement as long as the heap
+// of their memory type is big enough. Otherwise they are recreated and fixed is cleared for them. The caller is responsible for the replaced images
+static void renderGraphPlaceAndBindImages(RenderGraph* graph, StromboliContext* context, MemoryArena* scratch, struct RenderGraphImageLifetime* lifetimes, bool* fixed) {
+    u32 imageCount = graph->imageCount;
+
+    u64 requiredSizes[VK_MAX_MEMORY_TYPES] = {0};
+    VkPipelineStageFlags2 heapStages[VK_MAX_MEMORY_TYPES];
+    VkAccessFlags2 heapAccesses[VK_MAX_MEMORY_TYPES];
+    placeImages(scratch, lifetimes, imageCount, fixed, requiredSizes, graph->imageHeapStages, graph->imageHeapAccesses, heapStages, heapAccesses);
+
+    // A heap that is too small is replaced. Images bound to the old heap cannot be kept in that case
+    bool replaceHeaps[VK_MAX_MEMORY_TYPES] = {0};
+    bool replacedFixedImage = false;
+    for(u32 type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+        replaceHeaps[type] = requiredSizes[type] > graph->imageHeapSizes[type];
+    }
+    for(u32 i = 0; i < imageCount; ++i) {
+        if(fixed[i] && lifetimes[i].memoryType != UINT32_MAX && replaceHeaps[lifetimes[i].memoryType]) {
+            StromboliImage* image = &graph->images[i];
+            fixed[i] = false;
+            *image = renderGraphCreateFramebuffer(context, image->width, image->height, image->format, graph->imagePlacements[i].usage, image->samples, image->mipCount, graph->imagePlacements[i].layerCount, &lifetimes[i].memoryRequirements);
+            lifetimes[i].memoryType = findImageMemoryType(context, graph->imagePlacements[i].usage, lifetimes[i].memoryRequirements.memoryTypeBits);
+            replacedFixedImage = true;
+        }
+    }
+    if(replacedFixedImage) {
+        MEMORY_CLEAR(requiredSizes, sizeof(requiredSizes));
+        placeImages(scratch, lifetimes, imageCount, fixed, requiredSizes, graph->imageHeapStages, graph->imageHeapAccesses, heapStages, heapAccesses);
+    }
+    MEMORY_COPY(graph->imageHeapStages, heapStages, sizeof(heapStages));
+    MEMORY_COPY(graph->imageHeapAccesses, heapAccesses, sizeof(heapAccesses));
+
+    // Bind memory. All images of a memory type share one heap
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(context->physicalDevice, &memoryProperties);
+    u64 unaliasedSize = 0;
+    u64 peakSize = 0;
+    u64 lazySize = 0;
+    for(u32 type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+        if(requiredSizes[type] > graph->imageHeapSizes[type]) {
+            if(graph->imageHeaps[type]) {
+                // Pending executions might still use the old heap
+                retireResource(graph, RENDER_GRAPH_RETIRED_MEMORY)->memory = graph->imageHeaps[type];
+            }
+            VkMemoryAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+            allocateInfo.allocationSize = requiredSizes[type];
+            allocateInfo.memoryTypeIndex = type;
+            vkAllocateMemory(context->device, &allocateInfo, 0, &graph->imageHeaps[type]);
+            graph->imageHeapSizes[type] = requiredSizes[type];
+        }
+        peakSize += requiredSizes[type];
+        if(type < memoryProperties.memoryTypeCount && (memoryProperties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+            lazySize += requiredSizes[type];
+        }
+    }
+    for(u32 i = 0; i < imageCount; ++i) {
+        struct RenderGraphImageLifetime* lifetime = &lifetimes[i];
+        if(lifetime->memoryType == UINT32_MAX) {
+            continue;
+        }
+        if(!fixed[i]) {
+            renderGraphBindFramebuffer(context, &graph->images[i], graph->imagePlacements[i].layerCount, graph->imageHeaps[lifetime->memoryType], lifetime->offset);
+        }
+        graph->imagePlacements[i].memoryType = lifetime->memoryType;
+        graph->imagePlacements[i].offset = lifetime->offset;
+        graph->imagePlacements[i].memoryRequirements = lifetime->memoryRequirements;
+        if(lifetime->firstPass != UINT32_MAX) {
+            unaliasedSize += lifetime->memoryRequirements.size;
+        }
+    }
+
+    graph->aliasedImageCount = countAliasedImages(lifetimes, imageCount, scratch);
+    graph->imageMemorySize = unaliasedSize;
+    graph->imagePeakMemorySize = peakSize;
+    graph->imageLazyMemorySize = lazySize;
+}
+
+// 64 bit FNV-1a
+static u64 hashBytes(u64 hash, const void* data, u64 size) {
+    const u8* bytes = (const u8*)data;
+    for(u64 i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static u64 hashU32(u64 hash, u32 value) {
+    return hashBytes(hash, &value, sizeof(value));
+}
+
+static u64 hashU64(u64 hash, u64 value) {
+    return hashBytes(hash, &value, sizeof(value));
+}
+
+// Key of the properties a pooled image must match to be reused
+static u64 hashImageProperties(u32 width, u32 height, VkFormat format, VkSampleCountFlags samples, u32 mipCount, u32 layerCount, VkImageUsageFlags usage) {
+    u64 hash = 0xcbf29ce484222325ull;
+    hash = hashU32(hash, width);
+    hash = hashU32(hash, height);
+    hash = hashU32(hash, format);
+    hash = hashU32(hash, samples);
+    hash = hashU32(hash, mipCount);
+    hash = hashU32(hash, layerCount);
+    hash = hashU32(hash, usage);
+    return hash;
+}
+
+// Creates all graph images. Images of the old graph with the same extent, format, usage and samples are reused together with their memory placement
+// as long as the image heap of their memory type is big enough. Old images that are not reused are queued for deletion.
+// The lifetimes are allocated from the graph arena as renderGraphResize needs them to place resized images
+static struct RenderGraphImageLifetime* renderGraphAllocateImages(RenderGraphBuilder* builder, RenderGraph* result, MemoryArena* scratch, StromboliImage* pooledImages, struct RenderGraphImagePlacement* pooledPlacements, u32 pooledImageCount) {
+    StromboliContext* context = builder->context;
+    u32 imageCount = result->imageCount;
+    struct RenderGraphImageLifetime* lifetimes = ARENA_PUSH_ARRAY(&result->arena, imageCount, struct RenderGraphImageLifetime);
+    for(u32 i = 0; i < imageCount; ++i) {
+        lifetimes[i].firstPass = UINT32_MAX;
+        lifetimes[i].firstAccessPass = UINT32_MAX;
+    }
+
+    // Lifetime analysis
+    for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+        RenderGraphPass* pass = &result->sortedPasses[passIndex];
+        for(u32 i = 0; i < pass->inputCount + pass->outputCount; ++i) {
+            struct RenderAttachment* attachment = (i < pass->inputCount) ? &pass->inputs[i] : &pass->outputs[i - pass->inputCount];
+            struct RenderGraphImageLifetime* lifetime = &lifetimes[getImageHandleData(attachment->imageHandle)];
+            if(lifetime->firstPass == UINT32_MAX) {
+                lifetime->firstPass = passIndex;
+                lifetime->firstAccessPass = passIndex;
+            }
+            if(lifetime->lastPass != passIndex) {
+                lifetime->lastStage = 0;
+                lifetime->lastAccess = 0;
+            }
+            lifetime->lastPass = passIndex;
+            lifetime->lastStage |= attachment->stage;
+            lifetime->lastAccess |= attachment->access;
+            if(pass->queue != RENDER_GRAPH_QUEUE_GRAPHICS) {
+                lifetime->usedOnAsyncQueue = true;
+            }
+        }
+    }
+    // Reusing memory across queues would require additional semaphores. So images used on the async queue live for the whole graph
+    for(u32 i = 0; i < imageCount; ++i) {
+        if(lifetimes[i].usedOnAsyncQueue) {
+            lifetimes[i].firstPass = 0;
+            lifetimes[i].lastPass = result->passCount;
+        }
+    }
+    // Outputs of external passes (including the swapchain output) are used after the graph and must never be overwritten
+    for(u32 i = 0; i < result->buildPassCount; ++i) {
+        struct RenderGraphBuildPass* buildPass = &builder->passes[i];
+        if(buildPass->external && result->buildPassToSortedPass[i] != UINT16_MAX) {
+            for(u32 j = 0; j < buildPass->outputCount; ++j) {
+                lifetimes[getImageHandleData(buildPass->outputs[j].imageHandle)].lastPass = result->passCount;
+            }
+        }
+    }
+
+    // The final blit reads the swapchain output after its last pass. The next execution must not overwrite it before
+    struct RenderGraphImageLifetime* finalLifetime = &lifetimes[getImageHandleData(result->finalImageHandle)];
+    finalLifetime->lastStage |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    finalLifetime->lastAccess |= VK_ACCESS_TRANSFER_READ_BIT;
+
+    // Attachments that only live inside a single graphics pass are never loaded or stored. They become transient attachments
+    // which tile based GPUs keep in tile memory. Mostly depth buffers and multisampled images that are only resolved
+    VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    bool* transient = ARENA_PUSH_ARRAY(scratch, imageCount, bool);
+    u32 transientImageCount = 0;
+    for(u32 i = 0; i < imageCount; ++i) {
+        struct RenderGraphBuildImage* image = &builder->images[i];
+        struct RenderGraphImageLifetime* lifetime = &lifetimes[i];
+        if(image->importedSwapchain || lifetime->firstPass == UINT32_MAX || lifetime->firstPass != lifetime->lastPass || lifetime->lastPass >= result->passCount) {
+            continue;
+        }
+        if(result->sortedPasses[lifetime->firstPass].type != RENDER_GRAPH_PASS_TYPE_GRAPHICS || !(image->usage & attachmentUsage) || (image->usage & ~attachmentUsage)) {
+            continue;
+        }
+        transient[i] = true;
+        transientImageCount++;
+    }
+    result->transientImageCount = transientImageCount;
+
+    // Take matching images from the pool. Pool entries are sorted by the hash of their properties so every image finds its candidates with a binary search
+    result->imagePlacements = ARENA_PUSH_ARRAY(&result->arena, imageCount, struct RenderGraphImagePlacement);
+    bool* reused = ARENA_PUSH_ARRAY(scratch, imageCount, bool);
+    u32* poolEntries = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u32);
+    bool* takenFromPool = ARENA_PUSH_ARRAY(scratch, pooledImageCount, bool);
+    u32* poolOrder = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, pooledImageCount, u32);
+    u64* poolKeys = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, pooledImageCount, u64);
+    for(u32 j = 0; j < pooledImageCount; ++j) {
+        StromboliImage* pooledImage = &pooledImages[j];
+        poolOrder[j] = j;
+        poolKeys[j] = hashImageProperties(pooledImage->width, pooledImage->height, pooledImage->format, pooledImage->samples, pooledImage->mipCount, pooledPlacements[j].layerCount, pooledPlacements[j].usage);
+    }
+    sortImagesByKey(poolOrder, poolKeys, pooledImageCount, scratch);
+    for(u32 i = 0; i < imageCount; ++i) {
+        struct RenderGraphBuildImage* image = &builder->images[i];
+        struct RenderGraphImagePlacement* placement = &result->imagePlacements[i];
+        ASSERT(image->image.width);
+        ASSERT(image->image.height);
+        poolEntries[i] = UINT32_MAX;
+        placement->widthScale = image->widthScale;
+        placement->heightScale = image->heightScale;
+        placement->layerCount = image->layerCount;
+        if(image->importedSwapchain) {
+            // Gets the acquired swapchain image every frame. Takes part in neither placement nor binding
+            result->images[i] = (StromboliImage){.width = image->image.width, .height = image->image.height, .depth = 1, .mipCount = 1, .format = image->format, .samples = image->image.samples};
+            lifetimes[i].firstPass = UINT32_MAX;
+            lifetimes[i].memoryType = UINT32_MAX;
+            placement->memoryType = UINT32_MAX;
+            continue;
+        }
+        placement->usage = image->usage;
+        if(placement->usage <= 3) {
+            // Only transfer usage is not allowed so we add VK_IMAGE_USAGE_SAMPLED_BIT
+            placement->usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        }
+        if(transient[i]) {
+            placement->usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+        u64 key = hashImageProperties(image->image.width, image->image.height, image->format, image->image.samples, image->image.mipCount, image->layerCount, placement->usage);
+        u32 first = 0;
+        u32 last = pooledImageCount;
+        while(first < last) {
+            u32 middle = first + (last - first) / 2;
+            if(poolKeys[poolOrder[middle]] < key) {
+                first = middle + 1;
+            } else {
+                last = middle;
+            }
+        }
+        for(u32 k = first; k < pooledImageCount && poolKeys[poolOrder[k]] == key; ++k) {
+            u32 j = poolOrder[k];
+            StromboliImage* pooledImage = &pooledImages[j];
+            struct RenderGraphImagePlacement* pooledPlacement = &pooledPlacements[j];
+            if(takenFromPool[j] || pooledPlacement->memoryType == UINT32_MAX || pooledPlacement->usage != placement->usage || pooledImage->width != image->image.width ||
+                pooledImage->height != image->image.height || pooledImage->format != image->format || pooledImage->samples != image->image.samples ||
+                pooledImage->mipCount != image->image.mipCount || pooledPlacement->layerCount != image->layerCount) {
+                continue;
+            }
+            lifetimes[i].memoryType = pooledPlacement->memoryType;
+            lifetimes[i].offset = pooledPlacement->offset;
+            lifetimes[i].memoryRequirements = pooledPlacement->memoryRequirements;
+            reused[i] = true;
+            poolEntries[i] = j;
+            takenFromPool[j] = true;
+            break;
+        }
+    }
+
+    // A pooled image keeps its offset so it must not overlap another reused image that is alive at the same time. Sweeps over the reused images
+    // sorted by memory type and offset. Only images whose memory ranges overlap the current one are compared, which are few as the old graph aliased them
+    u32* reusedOrder = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u32);
+    u64* reusedKeys = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u64);
+    u32* activeImages = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u32);
+    u32 reusedCount = 0;
+    for(u32 i = 0; i < imageCount; ++i) {
+        if(reused[i]) {
+            reusedKeys[i] = lifetimes[i].offset;
+            reusedOrder[reusedCount++] = i;
+        }
+    }
+    sortImagesByKey(reusedOrder, reusedKeys, reusedCount, scratch);
+    for(u32 i = 0; i < reusedCount; ++i) {
+        reusedKeys[reusedOrder[i]] = lifetimes[reusedOrder[i]].memoryType;
+    }
+    sortImagesByKey(reusedOrder, reusedKeys, reusedCount, scratch);
+    u32 activeCount = 0;
+    for(u32 i = 0; i < reusedCount; ++i) {
+        struct RenderGraphImageLifetime* lifetime = &lifetimes[reusedOrder[i]];
+        u32 keptCount = 0;
+        bool collision = false;
+        for(u32 k = 0; k < activeCount; ++k) {
+            struct RenderGraphImageLifetime* active = &lifetimes[activeImages[k]];
+            if(!memoryRangesOverlap(lifetime, active)) {
+                // Ends before this image and therefore before all following ones
+                continue;
+            }
+            activeImages[keptCount++] = activeImages[k];
+            collision |= lifetimesOverlap(lifetime, active);
+        }
+        activeCount = keptCount;
+        if(collision) {
+            reused[reusedOrder[i]] = false;
+        } else {
+            activeImages[activeCount++] = reusedOrder[i];
+        }
+    }
+
+    for(u32 i = 0; i < imageCount; ++i) {
+        struct RenderGraphBuildImage* image = &builder->images[i];
+        struct RenderGraphImagePlacement* placement = &result->imagePlacements[i];
+        if(image->importedSwapchain) {
+            continue;
+        }
+        if(reused[i]) {
+            result->images[i] = pooledImages[poolEntries[i]];
+        } else {
+            result->images[i] = renderGraphCreateFramebuffer(context, image->image.width, image->image.height, image->format, placement->usage, image->image.samples, image->image.mipCount, image->layerCount, &lifetimes[i].memoryRequirements);
+            lifetimes[i].memoryType = findImageMemoryType(context, placement->usage, lifetimes[i].memoryRequirements.memoryTypeBits);
+        }
+    }
+
+    renderGraphPlaceAndBindImages(result, context, scratch, lifetimes, reused);
+
+    // Reused images that had to be recreated go back to the pool
+    u32 reusedImageCount = 0;
+    for(u32 i = 0; i < imageCount; ++i) {
+        if(reused[i]) {
+            reusedImageCount++;
+        } else if(poolEntries[i] != UINT32_MAX) {
+            takenFromPool[poolEntries[i]] = false;
+        }
+    }
+
+    // Pooled images that found no match are destroyed once pending executions have finished
+    for(u32 i = 0; i < pooledImageCount; ++i) {
+        if(!takenFromPool[i] && pooledPlacements[i].memoryType != UINT32_MAX) {
+            retireResource(result, RENDER_GRAPH_RETIRED_IMAGE)->image = pooledImages[i];
+        }
+    }
+
+    result->reusedImageCount = reusedImageCount;
+    result->imageLifetimes = lifetimes;
+
+    return lifetimes;
+}
+
+// Size of one texel when copying the color or depth aspect of an image into a buffer. 0 if the format is not supported
+static u32 getTexelCopySize(VkFormat format) {
+    switch(format) {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SNORM:
+        case VK_FORMAT_R8_UINT:
+        case VK_FORMAT_R8_SINT:
+        case VK_FORMAT_R8_SRGB:
+        case VK_FORMAT_S8_UINT:
+            return 1;
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R8G8_SNORM:
+        case VK_FORMAT_R8G8_UINT:
+        case VK_FORMAT_R8G8_SINT:
+        case VK_FORMAT_R16_UNORM:
+        case VK_FORMAT_R16_SFLOAT:
+        case VK_FORMAT_R16_UINT:
+        case VK_FORMAT_R16_SINT:
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+            return 2;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SNORM:
+        case VK_FORMAT_R8G8B8A8_UINT:
+        case VK_FORMAT_R8G8B8A8_SINT:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+        case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+        case VK_FORMAT_R16G16_UNORM:
+        case VK_FORMAT_R16G16_SFLOAT:
+        case VK_FORMAT_R32_SFLOAT:
+        case VK_FORMAT_R32_UINT:
+        case VK_FORMAT_R32_SINT:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_UNORM:
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R16G16B16A16_UINT:
+        case VK_FORMAT_R32G32_SFLOAT:
+        case VK_FORMAT_R32G32_UINT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+        case VK_FORMAT_R32G32B32A32_UINT:
+        case VK_FORMAT_R32G32B32A32_SINT:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+// Host cached memory makes reading on the CPU fast but might not exist everywhere
+static void createReadbackBuffers(StromboliContext* context, struct RenderGraphReadback* readback, StromboliImage* image) {
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(context->physicalDevice, &memoryProperties);
+    VkMemoryPropertyFlags readbackMemoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for(u32 i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        if((memoryProperties.memoryTypes[i].propertyFlags & cached) == cached) {
+            readbackMemoryProperties = cached;
+            break;
+        }
+    }
+    for(u32 i = 0; i < RENDER_GRAPH_READBACK_RING_SIZE; ++i) {
+        readback->buffers[i] = stromboliCreateBuffer(context, (u64)image->width * image->height * readback->texelSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackMemoryProperties, 0);
+        readback->executionIndices[i] = UINT64_MAX;
+    }
+}
+
+// The swapchain output can only be replaced by the swapchain image if nothing but its producer ever touches it and the properties match
+static bool canRenderDirectlyToSwapchain(RenderGraphBuilder* builder, RenderGraphImageHandle swapchainOutputHandle) {
+    StromboliSwapchain* swapchain = builder->swapchain;
+    struct RenderGraphBuildImage* image = getImageFromHandle(builder, swapchainOutputHandle);
+    if(!swapchain || !image || !image->producer.handle) {
+        return false;
+    }
+    if(image->format != swapchain->format || image->image.width != swapchain->width || image->image.height != swapchain->height || image->image.samples != VK_SAMPLE_COUNT_1_BIT) {
+        return false;
+    }
+    if(image->usage & ~swapchain->usage) {
+        return false;
+    }
+    if(getPassFromHandle(builder, image->producer)->type != RENDER_GRAPH_PASS_TYPE_GRAPHICS) {
+        return false;
+    }
+    u32 writerCount = 0;
+    for(u32 i = 0; i < builder->currentPassIndex - 1; ++i) {
+        struct RenderGraphBuildPass* pass = &builder->passes[i];
+        for(u32 j = 0; j < pass->inputCount; ++j) {
+            if(imageHandlesOverlap(pass->inputs[j].imageHandle, swapchainOutputHandle)) {
+                return false;
+            }
+        }
+        for(u32 j = 0; j < pass->outputCount; ++j) {
+            if(imageHandlesOverlap(pass->outputs[j].imageHandle, swapchainOutputHandle)) {
+                writerCount++;
+            }
+        }
+    }
+    return writerCount == 1;
+}
+
+static struct RenderGraphMemoryBlock* copyAndResetMemoryBlockList(MemoryArena* arena, struct RenderGraphMemoryBlock* firstBlock) {
+    struct RenderGraphMemoryBlock* result = 0;
+
+    struct RenderGraphMemoryBlock* memoryBlock = firstBlock;
+    struct RenderGraphMemoryBlock** nextPointerLocation = &result;
+    while(memoryBlock) {
+        struct RenderGraphMemoryBlock* newBlock = ARENA_PUSH_STRUCT_NO_CLEAR(arena, struct RenderGraphMemoryBlock);
+        ASSUME(newBlock) {
+            MEMORY_COPY_STRUCT(newBlock, memoryBlock);
+            newBlock->next = 0;
+            newBlock->offset = 0;
+            *nextPointerLocation = newBlock;
+            nextPointerLocation = &newBlock->next;
+            memoryBlock = memoryBlock->next;
+        }
+    }
+
+    return result;
+}
+
+// Stages and accesses a barrier on the async compute queue can wait for
+#define ASYNC_QUEUE_STAGES (VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT | \
+    VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT)
+#define ASYNC_QUEUE_ACCESSES (VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_UNIFORM_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | \
+    VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+
+// Restricts the source scope of the first access of a resource in an execution to what the queue of the accessing pass supports.
+// Accesses of the previous execution on the other queue are ordered by the frame semaphores, which are waited for at all stages.
+// The source stage is never empty so the barrier chains with that wait. dstStage is the fallback as it is always supported by the queue
+static void restrictFirstAccessScope(u32 queue, VkPipelineStageFlags2 dstStage, VkPipelineStageFlags2* srcStage, VkAccessFlags2* srcAccess) {
+    if(queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE) {
+        *srcStage &= ASYNC_QUEUE_STAGES;
+        *srcAccess &= ASYNC_QUEUE_ACCESSES;
+    }
+    if(!*srcStage) {
+        *srcStage = dstStage;
+    }
+}
+
+// Synchronization state of a resource while walking the sorted passes
+struct RenderGraphResourceState {
+    VkImageLayout layout;
+    VkPipelineStageFlags2 srcStage; // Stages the next dependency has to wait for. Either the last write or the last layout transition
+    VkAccessFlags2 srcAccess; // Writes that still have to be made available
+    VkPipelineStageFlags2 readStages; // Reads since srcStage. Writes and layout transitions have to wait for them
+    VkPipelineStageFlags2 visibleStages; // The current content is already visible to these stages and accesses
+    VkAccessFlags2 visibleAccess;
+    u32 barrierPass; // Pass that contains the last barrier of this resource. UINT32_MAX if there is none
+    u32 barrierIndex;
+    u32 srcPass; // Pass that performed the accesses in srcStage
+    u32 lastReadPass; // Last pass that contributed to readStages
+    u32 queueMask; // Queues that accessed the resource since srcPass
+};
+
+static void resetResourceState(struct RenderGraphResourceState* state, VkImageLayout layout, VkPipelineStageFlags2 stage, VkAccessFlags2 access, RenderGraphPass* pass, u32 passIndex) {
+    *state = (struct RenderGraphResourceState){
+        .layout = layout,
+        .srcStage = stage,
+        .srcAccess = access,
+        .barrierPass = UINT32_MAX,
+        .srcPass = passIndex,
+        .lastReadPass = passIndex,
+        .queueMask = 1 << pass->queue,
+    };
+}
+
+// Decides what an input needs. Returns false if the input can reuse an earlier barrier. The src and dst scopes of the dependency are always written so a barrier can be created from them.
+// eventPass receives the last pass the dependency waits for or UINT32_MAX if passes on another queue are involved
+static bool syncResourceRead(struct RenderGraphResourceState* state, VkImageLayout layout, VkPipelineStageFlags2 stage, VkAccessFlags2 access, bool writtenByPass, RenderGraphPass* pass, u32 passIndex, VkPipelineStageFlags2* srcStage, VkAccessFlags2* srcAccess, u32* eventPass) {
+    *srcStage = state->srcStage;
+    *srcAccess = state->srcAccess;
+    *eventPass = state->srcPass;
+    if(layout != state->layout || writtenByPass) {
+        // Layout transitions and writes must not overtake earlier reads
+        *srcStage |= state->readStages;
+        *eventPass = MAX(state->srcPass, state->lastReadPass);
+    }
+    if(state->queueMask != (1u << pass->queue)) {
+        *eventPass = UINT32_MAX;
+    }
+    if(!*srcStage) {
+        *srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+    bool visible = (stage & ~state->visibleStages) == 0 && (access & ~state->visibleAccess) == 0;
+    state->queueMask |= 1 << pass->queue;
+    if(layout == state->layout && !writtenByPass && visible) {
+        // Read after read. An earlier barrier already covers this access
+        state->readStages |= stage;
+        state->lastReadPass = passIndex;
+        return false;
+    }
+    if(layout != state->layout) {
+        // Following accesses only have to wait for the transition
+        state->layout = layout;
+        state->srcStage = stage;
+        state->srcAccess = 0;
+        state->readStages = stage;
+        state->visibleStages = stage;
+        state->visibleAccess = access;
+        state->srcPass = passIndex;
+        state->queueMask = 1 << pass->queue;
+    } else {
+        state->readStages |= stage;
+        state->visibleStages |= stage;
+        state->visibleAccess |= access;
+    }
+    state->lastReadPass = passIndex;
+    return true;
+}
+
+struct RenderGraphResourceOwner {
+    u32 queue; // UINT32_MAX before the first access
+    u32 lastPass;
+    VkPipelineStageFlags2 lastStage; // Stages of all accesses in lastPass
+    VkAccessFlags2 lastAccess;
+    VkImageLayout layout;
+};
+
+static void updateResourceOwner(struct RenderGraphResourceOwner* owner, RenderGraphPass* pass, u32 passIndex, VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout) {
+    if(owner->lastPass != passIndex || owner->queue != pass->queue) {
+        owner->lastStage = 0;
+        owner->lastAccess = 0;
+    }
+    owner->queue = pass->queue;
+    owner->lastPass = passIndex;
+    owner->lastStage |= stage;
+    owner->lastAccess |= access;
+    owner->layout = layout;
+}
+
+// Walks the sorted passes and tracks which queue currently owns each resource. Whenever a resource changes queue
+// the barrier of the consuming pass becomes an acquire, the last pass on the old queue gets a matching release and the consuming pass has to wait for it with a semaphore.
+// Passes are then grouped into submit batches. Each batch waits at most for one batch of the other queue
+static void scheduleQueues(RenderGraphBuilder* builder, RenderGraph* result, MemoryArena* scratch, VkSemaphore* oldSemaphores, u32 oldSemaphoreCount);
+
+// Returns the event dependency between setPass and pass. Dependencies of a pass are created consecutively while compacting its barriers
+static struct RenderGraphEventDependency* getEventDependency(RenderGraph* result, RenderGraphPass* pass, u32 passIndex, u32 setPass) {
+    for(u32 i = pass->firstEventWait; i < result->eventDependencyCount; ++i) {
+        if(result->eventDependencies[i].setPass == setPass) {
+            return &result->eventDependencies[i];
+        }
+    }
+    struct RenderGraphEventDependency* dependency = &result->eventDependencies[result->eventDependencyCount++];
+    pass->eventWaitCount++;
+    dependency->setPass = setPass;
+    dependency->waitPass = passIndex;
+    dependency->imageBarriers = ARENA_PUSH_ARRAY(&result->arena, pass->inputCount, VkImageMemoryBarrier2KHR);
+    dependency->bufferBarriers = ARENA_PUSH_ARRAY(&result->arena, pass->bufferInputCount, VkBufferMemoryBarrier2KHR);
+    dependency->dependencyInfo = (VkDependencyInfoKHR){VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR};
+    dependency->dependencyInfo.pImageMemoryBarriers = dependency->imageBarriers;
+    dependency->dependencyInfo.pBufferMemoryBarriers = dependency->bufferBarriers;
+    return dependency;
+}
+
+// Drops input barriers that are covered by earlier barriers. Queue family ownership transfers are always kept.
+// Barriers that only wait for a pass at least RENDER_GRAPH_SPLIT_BARRIER_DISTANCE passes back on the same queue become event dependencies,
+// so the passes in between do not have to drain before the consumer starts
+static void removeRedundantBarriers(RenderGraph* result, bool** redundantImageBarriers, bool** redundantBufferBarriers, u32** imageEventPasses, u32** bufferEventPasses) {
+    bool splitBarriers = RENDER_GRAPH_SPLIT_BARRIER_DISTANCE > 0 && vkCmdSetEvent2KHR && vkCmdWaitEvents2KHR;
+    u32 maxDependencyCount = 0;
+    for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+        maxDependencyCount += result->sortedPasses[passIndex].inputCount + result->sortedPasses[passIndex].bufferInputCount;
+    }
+    result->eventDependencies = ARENA_PUSH_ARRAY(&result->arena, maxDependencyCount, struct RenderGraphEventDependency);
+    result->eventDependencyCount = 0;
+
+    u32 removedCount = 0;
+    u32 barrierCount = 0;
+    u32 splitCount = 0;
+    for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+        RenderGraphPass* pass = &result->sortedPasses[passIndex];
+        pass->firstEventWait = result->eventDependencyCount;
+        pass->eventWaitCount = 0;
+        u32 imageBarrierCount = 0;
+        for(u32 i = 0; i < pass->imageBarrierCount; ++i) {
+            VkImageMemoryBarrier2KHR* barrier = &pass->imageBarriers[i];
+            bool ownershipTransfer = barrier->srcQueueFamilyIndex != barrier->dstQueueFamilyIndex;
+            if(i < pass->inputCount && redundantImageBarriers[passIndex][i] && !ownershipTransfer) {
+                removedCount++;
+                continue;
+            }
+            u32 eventPass = i < pass->inputCount ? imageEventPasses[passIndex][i] : UINT32_MAX;
+            if(splitBarriers && !ownershipTransfer && eventPass != UINT32_MAX && eventPass + RENDER_GRAPH_SPLIT_BARRIER_DISTANCE <= passIndex) {
+                struct RenderGraphEventDependency* dependency = getEventDependency(result, pass, passIndex, eventPass);
+                dependency->imageBarriers[dependency->dependencyInfo.imageMemoryBarrierCount++] = *barrier;
+                splitCount++;
+                continue;
+            }
+            pass->imageBarriers[imageBarrierCount++] = *barrier;
+        }
+        pass->imageBarrierCount = imageBarrierCount;
+        u32 bufferBarrierCount = 0;
+        for(u32 i = 0; i < pass->bufferBarrierCount; ++i) {
+            VkBufferMemoryBarrier2KHR* barrier = &pass->bufferBarriers[i];
+            bool ownershipTransfer = barrier->srcQueueFamilyIndex != barrier->dstQueueFamilyIndex;
+            if(redundantBufferBarriers[passIndex][i] && !ownershipTransfer) {
+                removedCount++;
+                continue;
+            }
+            u32 eventPass = bufferEventPasses[passIndex][i];
+            if(splitBarriers && !ownershipTransfer && eventPass != UINT32_MAX && eventPass + RENDER_GRAPH_SPLIT_BARRIER_DISTANCE <= passIndex) {
+                struct RenderGraphEventDependency* dependency = getEventDependency(result, pass, passIndex, eventPass);
+                dependency->bufferBarriers[dependency->dependencyInfo.bufferMemoryBarrierCount++] = *barrier;
+                splitCount++;
+                continue;
+            }
+            pass->bufferBarriers[bufferBarrierCount++] = *barrier;
+        }
+        pass->bufferBarrierCount = bufferBarrierCount;
+        barrierCount += imageBarrierCount + bufferBarrierCount + pass->afterClearBarrierCount + pass->afterClearBufferBarrierCount + pass->releaseImageBarrierCount + pass->releaseBufferBarrierCount;
+    }
+
+    // Every pass needs to know which events it sets
+    for(u32 i = 0; i < result->eventDependencyCount; ++i) {
+        result->sortedPasses[result->eventDependencies[i].setPass].eventSetCount++;
+    }
+    for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+        RenderGraphPass* pass = &result->sortedPasses[passIndex];
+        pass->eventSets = ARENA_PUSH_ARRAY_NO_CLEAR(&result->arena, pass->eventSetCount, u32);
+        pass->eventSetCount = 0;
+    }
+    for(u32 i = 0; i < result->eventDependencyCount; ++i) {
+        RenderGraphPass* setPass = &result->sortedPasses[result->eventDependencies[i].setPass];
+        setPass->eventSets[setPass->eventSetCount++] = i;
+    }
+
+    result->barrierCount = barrierCount + splitCount;
+    result->removedBarrierCount = removedCount;
+    result->splitBarrierCount = splitCount;
+}
+
+static void scheduleQueues(RenderGraphBuilder* builder, RenderGraph* result, MemoryArena* scratch, VkSemaphore* oldSemaphores, u32 oldSemaphoreCount) {
+    StromboliContext* context = builder->context;
+    u32 familyIndices[RENDER_GRAPH_QUEUE_COUNT];
+    familyIndices[RENDER_GRAPH_QUEUE_GRAPHICS] = context->graphicsQueues[0].familyIndex;
+    familyIndices[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE] = context->computeQueueCount ? context->computeQueues[0].familyIndex : context->graphicsQueues[0].familyIndex;
+
+    struct RenderGraphResourceOwner* imageOwners = ARENA_PUSH_ARRAY(scratch, result->imageCount, struct RenderGraphResourceOwner);
+    struct RenderGraphResourceOwner* bufferOwners = ARENA_PUSH_ARRAY(scratch, result->bufferCount, struct RenderGraphResourceOwner);
+    for(u32 i = 0; i < result->imageCount; ++i) {
+        imageOwners[i].queue = UINT32_MAX;
+    }
+    for(u32 i = 0; i < result->bufferCount; ++i) {
+        bufferOwners[i].queue = UINT32_MAX;
+    }
+    u32* waitPasses = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, result->passCount, u32);
+    VkPipelineStageFlags2* waitStages = ARENA_PUSH_ARRAY(scratch, result->passCount, VkPipelineStageFlags2);
+
+    for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+        RenderGraphPass* pass = &result->sortedPasses[passIndex];
+        waitPasses[passIndex] = UINT32_MAX;
+        pass->releaseImageBarriers = ARENA_PUSH_ARRAY(&result->arena, pass->inputCount + pass->outputCount, VkImageMemoryBarrier2KHR);
+        pass->releaseBufferBarriers = ARENA_PUSH_ARRAY(&result->arena, pass->bufferInputCount + pass->bufferOutputCount, VkBufferMemoryBarrier2KHR);
+
+        // Image barriers start with one barrier per input in input order
+        for(u32 i = 0; i < pass->inputCount; ++i) {
+            struct RenderAttachment* input = &pass->inputs[i];
+            struct RenderGraphResourceOwner* owner = &imageOwners[getImageHandleData(input->imageHandle)];
+            RenderGraphPass* producer = &result->sortedPasses[result->buildPassToSortedPass[getPassIndex(input->producer)]];
+            VkImageMemoryBarrier2KHR* barrier = &pass->imageBarriers[i];
+            ASSERT(owner->queue != UINT32_MAX);
+            if(owner->queue != pass->queue) {
+                // The semaphore orders the accesses between the queues. The acquire uses the stages the semaphore wait blocks
+                // so it chains with the wait
+                barrier->srcStageMask = input->stage;
+                barrier->srcAccessMask = 0;
+                barrier->oldLayout = owner->layout;
+                if(familyIndices[owner->queue] != familyIndices[pass->queue]) {
+                    barrier->srcQueueFamilyIndex = familyIndices[owner->queue];
+                    barrier->dstQueueFamilyIndex = familyIndices[pass->queue];
+                    VkImageMemoryBarrier2KHR release = *barrier;
+                    release.srcStageMask = owner->lastStage;
+                    release.srcAccessMask = owner->lastAccess;
+                    release.dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+                    release.dstAccessMask = 0;
+                    RenderGraphPass* releasePass = &result->sortedPasses[owner->lastPass];
+                    releasePass->releaseImageBarriers[releasePass->releaseImageBarrierCount++] = release;
+                }
+                waitPasses[passIndex] = (waitPasses[passIndex] == UINT32_MAX) ? owner->lastPass : MAX(waitPasses[passIndex], owner->lastPass);
+                waitStages[passIndex] |= input->stage;
+            } else if(producer->queue != pass->queue) {
+                // Already transferred to our queue by an earlier pass. The producer stages might not even exist on this queue
+                barrier->srcStageMask = owner->lastStage;
+                barrier->srcAccessMask = owner->lastAccess;
+                barrier->oldLayout = owner->layout;
+            }
+            updateResourceOwner(owner, pass, passIndex, input->stage, input->access, input->layout);
+        }
+        for(u32 i = 0; i < pass->outputCount; ++i) {
+            struct RenderAttachment* output = &pass->outputs[i];
+            updateResourceOwner(&imageOwners[getImageHandleData(output->imageHandle)], pass, passIndex, output->stage, output->access, output->layout);
+        }
+        if(passIndex == result->swapchainOutputPassIndex) {
+            // The final blit happens at the end of this pass
+            struct RenderGraphResourceOwner* owner = &imageOwners[getImageHandleData(result->finalImageHandle)];
+            owner->lastStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            owner->lastAccess = VK_ACCESS_TRANSFER_READ_BIT;
+            owner->layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        }
+
+        for(u32 i = 0; i < pass->bufferInputCount; ++i) {
+            struct RenderBufferAttachment* input = &pass->bufferInputs[i];
+            struct RenderGraphResourceOwner* owner = &bufferOwners[getBufferHandleData(input->bufferHandle)];
+            RenderGraphPass* producer = &result->sortedPasses[result->buildPassToSortedPass[getPassIndex(input->producer)]];
+            VkBufferMemoryBarrier2KHR* barrier = &pass->bufferBarriers[i];
+            ASSERT(owner->queue != UINT32_MAX);
+            if(owner->queue != pass->queue) {
+                barrier->srcStageMask = input->stage;
+                barrier->srcAccessMask = 0;
+                if(familyIndices[owner->queue] != familyIndices[pass->queue]) {
+                    barrier->srcQueueFamilyIndex = familyIndices[owner->queue];
+                    barrier->dstQueueFamilyIndex = familyIndices[pass->queue];
+                    VkBufferMemoryBarrier2KHR release = *barrier;
+                    release.srcStageMask = owner->lastStage;
+                    release.srcAccessMask = owner->lastAccess;
+                    release.dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+                    release.dstAccessMask = 0;
+                    RenderGraphPass* releasePass = &result->sortedPasses[owner->lastPass];
+                    releasePass->releaseBufferBarriers[releasePass->releaseBufferBarrierCount++] = release;
+                }
+                waitPasses[passIndex] = (waitPasses[passIndex] == UINT32_MAX) ? owner->lastPass : MAX(waitPasses[passIndex], owner->lastPass);
+                waitStages[passIndex] |= input->stage;
+            } else if(producer->queue != pass->queue) {
+                barrier->srcStageMask = owner->lastStage;
+                barrier->srcAccessMask = owner->lastAccess;
+            }
+            updateResourceOwner(owner, pass, passIndex, input->stage, input->access, VK_IMAGE_LAYOUT_UNDEFINED);
+        }
+        for(u32 i = 0; i < pass->bufferOutputCount; ++i) {
+            struct RenderBufferAttachment* output = &pass->bufferOutputs[i];
+            updateResourceOwner(&bufferOwners[getBufferHandleData(output->bufferHandle)], pass, passIndex, output->stage, output->access, VK_IMAGE_LAYOUT_UNDEFINED);
+        }
+    }
+
+    // Group passes into batches. A new batch starts when the queue changes or a pass has to wait for work on the other queue that has not been waited for yet
+    result->batches = ARENA_PUSH_ARRAY(&result->arena, result->passCount, struct RenderGraphSubmitBatch);
+    result->batchCount = 0;
+    u32* passBatches = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, result->passCount, u32);
+    u32 lastWaitedPass[RENDER_GRAPH_QUEUE_COUNT] = {UINT32_MAX, UINT32_MAX};
+    u32 waitingBatches[RENDER_GRAPH_QUEUE_COUNT] = {UINT32_MAX, UINT32_MAX};
+    u32 waitedBatchCount = 0;
+    for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+        RenderGraphPass* pass = &result->sortedPasses[passIndex];
+        u32 waitPass = waitPasses[passIndex];
+        bool needsWait = waitPass != UINT32_MAX && (lastWaitedPass[pass->queue] == UINT32_MAX || waitPass > lastWaitedPass[pass->queue]);
+        if(!result->batchCount || result->batches[result->batchCount-1].queue != pass->queue || needsWait) {
+            result->batches[result->batchCount++] = (struct RenderGraphSubmitBatch) {
+                .queue = pass->queue,
+                .firstPass = passIndex,
+                .waitBatch = UINT32_MAX,
+            };
+        }
+        struct RenderGraphSubmitBatch* batch = &result->batches[result->batchCount-1];
+        batch->passCount++;
+        passBatches[passIndex] = result->batchCount-1;
+        if(needsWait) {
+            // The waited batch is on the other queue and therefore already complete
+            u32 waitBatch = passBatches[waitPass];
+            batch->waitBatch = waitBatch;
+            lastWaitedPass[pass->queue] = result->batches[waitBatch].firstPass + result->batches[waitBatch].passCount - 1;
+            waitingBatches[pass->queue] = result->batchCount-1;
+            waitedBatchCount++;
+        }
+        if(waitPass != UINT32_MAX) {
+            // Passes covered by an earlier wait still need their stages blocked by that wait
+            ASSERT(waitingBatches[pass->queue] != UINT32_MAX);
+            result->batches[waitingBatches[pass->queue]].waitStage |= waitStages[passIndex];
+        }
+    }
+
+    // Pass batching records all passes of a batch into the command buffer of its first pass. The swapchain output pass is only finished
+    // when executing, so it always ends its command buffer. Static passes keep their own command buffers. Passes with secondary command
+    // buffers do too, as their secondary command buffers are only complete once the pass is ended
+    result->commandBufferCount = 0;
+    for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+        RenderGraphPass* pass = &result->sortedPasses[passIndex];
+        RenderGraphPass* previous = passIndex > 0 ? &result->sortedPasses[passIndex-1] : 0;
+        pass->batched = builder->batchPasses && previous && passBatches[passIndex] == passBatches[passIndex-1] && passIndex-1 != result->swapchainOutputPassIndex &&
+            !pass->staticPass && !previous->staticPass && !pass->secondaryCommandBufferCount && !previous->secondaryCommandBufferCount;
+        if(pass->batched) {
+            pass->commandBufferIndex = result->sortedPasses[passIndex-1].commandBufferIndex;
+        } else {
+            pass->commandBufferIndex = passIndex;
+            result->commandBufferCount++;
+        }
+    }
+
+    // The fence is signaled on the graphics queue. If no graphics batch waits for the last async batch a separate join submission is required
+    result->joinBatch = UINT32_MAX;
+    for(u32 i = result->batchCount; i > 0; --i) {
+        struct RenderGraphSubmitBatch* batch = &result->batches[i-1];
+        if(batch->queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE) {
+            u32 lastPass = batch->firstPass + batch->passCount - 1;
+            if(lastWaitedPass[RENDER_GRAPH_QUEUE_GRAPHICS] == UINT32_MAX || lastWaitedPass[RENDER_GRAPH_QUEUE_GRAPHICS] < lastPass) {
+                result->joinBatch = i-1;
+                waitedBatchCount++;
+            }
+            break;
+        }
+    }
+
+    // Binary semaphores are signaled and waited exactly once per execution so they can be reused across compiles.
+    // Every frame slot needs its own set as the previous execution might still wait on them
+    result->queueSemaphoreCount = MAX(waitedBatchCount * RENDER_GRAPH_FRAMES_IN_FLIGHT, oldSemaphoreCount);
+    result->queueSemaphores = ARENA_PUSH_ARRAY(&result->arena, result->queueSemaphoreCount, VkSemaphore);
+    MEMORY_COPY(result->queueSemaphores, oldSemaphores, sizeof(VkSemaphore) * oldSemaphoreCount);
+    for(u32 i = oldSemaphoreCount; i < result->queueSemaphoreCount; ++i) {
+        VkSemaphoreCreateInfo createInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        vkCreateSemaphore(context->device, &createInfo, 0, &result->queueSemaphores[i]);
+    }
+    u32 semaphoreIndex = 0;
+    for(u32 i = 0; i < result->batchCount; ++i) {
+        struct RenderGraphSubmitBatch* batch = &result->batches[i];
+        if(batch->waitBatch != UINT32_MAX) {
+            for(u32 slot = 0; slot < RENDER_GRAPH_FRAMES_IN_FLIGHT; ++slot) {
+                result->batches[batch->waitBatch].signalSemaphores[slot] = result->queueSemaphores[semaphoreIndex++];
+            }
+        }
+    }
+    if(result->joinBatch != UINT32_MAX) {
+        for(u32 slot = 0; slot < RENDER_GRAPH_FRAMES_IN_FLIGHT; ++slot) {
+            result->batches[result->joinBatch].signalSemaphores[slot] = result->queueSemaphores[semaphoreIndex++];
+        }
+    }
+    ASSERT(semaphoreIndex == waitedBatchCount * RENDER_GRAPH_FRAMES_IN_FLIGHT);
+}
+
+// Handles are hashed without their fingerprint as it changes with every builder
+static u64 hashAttachment(u64 hash, struct RenderAttachment* attachment) {
+    hash = hashU32(hash, attachment->layout);
+    hash = hashU32(hash, attachment->access);
+    hash = hashU64(hash, attachment->stage);
+    hash = hashU32(hash, attachment->usage);
+    hash = hashU32(hash, getImageHandleData(attachment->imageHandle));
+    hash = hashU32(hash, getImageSubresourceData(attachment->imageHandle));
+    hash = hashU32(hash, getPassHandleData(attachment->producer));
+    hash = hashU32(hash, attachment->requiresClear);
+    hash = hashU32(hash, attachment->resolveTarget);
+    hash = hashU32(hash, getImageHandleData(attachment->resolve));
+    hash = hashU32(hash, attachment->resolveMode);
+    return hash;
+}
+
+static u64 hashBufferAttachment(u64 hash, struct RenderBufferAttachment* attachment) {
+    hash = hashU64(hash, attachment->access);
+    hash = hashU64(hash, attachment->stage);
+    hash = hashU32(hash, attachment->usage);
+    hash = hashU32(hash, getBufferHandleData(attachment->bufferHandle));
+    hash = hashU32(hash, getPassHandleData(attachment->producer));
+    hash = hashU32(hash, attachment->requiresClear);
+    return hash;
+}
+
+// Hashes everything that influences the compiled graph except clear values, which are patched in when the cached graph is reused
+static u64 hashBuilder(RenderGraphBuilder* builder, RenderGraphImageHandle swapchainOutputHandle) {
+    u64 hash = 0xcbf29ce484222325ull;
+    hash = hashU32(hash, builder->currentPassIndex);
+    hash = hashU32(hash, builder->currentResourceIndex);
+    hash = hashU32(hash, builder->currentBufferIndex);
+    hash = hashU32(hash, getImageHandleData(swapchainOutputHandle));
+    hash = hashU32(hash, builder->scheduleMode);
+    hash = hashU32(hash, builder->batchPasses);
+    // The swapchain extent itself is not part of the hash so a resize can be handled by renderGraphResize
+    hash = hashU32(hash, canRenderDirectlyToSwapchain(builder, swapchainOutputHandle));
+    for(u32 i = 0; i < builder->currentPassIndex - 1; ++i) {
+        struct RenderGraphBuildPass* pass = &builder->passes[i];
+        hash = hashBytes(hash, pass->name.base, pass->name.size);
+        hash = hashU32(hash, pass->type);
+        hash = hashU32(hash, pass->external);
+        hash = hashU32(hash, pass->async);
+        hash = hashU32(hash, pass->staticPass);
+        hash = hashU32(hash, pass->secondaryCommandBufferCount);
+        hash = hashU32(hash, pass->viewMask);
+        hash = hashU32(hash, pass->readback);
+        hash = hashU32(hash, pass->inputCount);
+        hash = hashU32(hash, pass->outputCount);
+        hash = hashU32(hash, pass->bufferInputCount);
+        hash = hashU32(hash, pass->bufferOutputCount);
+        for(u32 j = 0; j < pass->inputCount; ++j) {
+            hash = hashAttachment(hash, &pass->inputs[j]);
+        }
+        for(u32 j = 0; j < pass->outputCount; ++j) {
+            hash = hashAttachment(hash, &pass->outputs[j]);
+        }
+        for(u32 j = 0; j < pass->bufferInputCount; ++j) {
+            hash = hashBufferAttachment(hash, &pass->bufferInputs[j]);
+        }
+        for(u32 j = 0; j < pass->bufferOutputCount; ++j) {
+            hash = hashBufferAttachment(hash, &pass->bufferOutputs[j]);
+        }
+    }
+    for(u32 i = 0; i < builder->currentResourceIndex; ++i) {
+        struct RenderGraphBuildImage* image = &builder->images[i];
+        if(image->widthScale > 0.0f) {
+            // Relative images only depend on their scale
+            hash = hashBytes(hash, &image->widthScale, sizeof(image->widthScale));
+            hash = hashBytes(hash, &image->heightScale, sizeof(image->heightScale));
+        } else {
+            hash = hashU32(hash, image->image.width);
+            hash = hashU32(hash, image->image.height);
+        }
+        hash = hashU32(hash, image->image.samples);
+        hash = hashU32(hash, image->image.mipCount);
+        hash = hashU32(hash, image->layerCount);
+        hash = hashU32(hash, image->format);
+        hash = hashU32(hash, image->usage);
+        hash = hashU32(hash, getPassHandleData(image->producer));
+        hash = hashU32(hash, image->requiresClear);
+    }
+    for(u32 i = 0; i < builder->currentBufferIndex; ++i) {
+        struct RenderGraphBuildBuffer* buffer = &builder->buffers[i];
+        hash = hashU64(hash, buffer->size);
+        hash = hashU32(hash, buffer->usage);
+        hash = hashU32(hash, getPassHandleData(buffer->producer));
+        hash = hashU32(hash, buffer->requiresClear);
+    }
+    return hash;
+}
+
+// Compares everything hashAttachment covers
+static bool attachmentsMatch(struct RenderAttachment* a, struct RenderAttachment* b) {
+    return a->layout == b->layout && a->access == b->access && a->stage == b->stage && a->usage == b->usage &&
+        getImageHandleData(a->imageHandle) == getImageHandleData(b->imageHandle) && getImageSubresourceData(a->imageHandle) == getImageSubresourceData(b->imageHandle) &&
+        getPassHandleData(a->producer) == getPassHandleData(b->producer) && a->requiresClear == b->requiresClear && a->resolveTarget == b->resolveTarget &&
+        getImageHandleData(a->resolve) == getImageHandleData(b->resolve) && a->resolveMode == b->resolveMode;
+}
+
+static bool bufferAttachmentsMatch(struct RenderBufferAttachment* a, struct RenderBufferAttachment* b) {
+    return a->access == b->access && a->stage == b->stage && a->usage == b->usage && getBufferHandleData(a->bufferHandle) == getBufferHandleData(b->bufferHandle) &&
+        getPassHandleData(a->producer) == getPassHandleData(b->producer) && a->requiresClear == b->requiresClear;
+}
+
+// Compares everything hashBuilder covers of an image
+static bool buildImagesMatch(struct RenderGraphBuildImage* a, struct RenderGraphBuildImage* b) {
+    if(a->widthScale != b->widthScale || a->heightScale != b->heightScale) {
+        return false;
+    }
+    if(a->widthScale <= 0.0f && (a->image.width != b->image.width || a->image.height != b->image.height)) {
+        return false;
+    }
+    return a->image.samples == b->image.samples && a->image.mipCount == b->image.mipCount && a->layerCount == b->layerCount && a->format == b->format &&
+        a->usage == b->usage && getPassHandleData(a->producer) == getPassHandleData(b->producer) && a->requiresClear == b->requiresClear;
+}
+
+// Compares everything hashBuilder covers of a buffer
+static bool buildBuffersMatch(struct RenderGraphBuildBuffer* a, struct RenderGraphBuildBuffer* b) {
+    return a->size == b->size && a->usage == b->usage && getPassHandleData(a->producer) == getPassHandleData(b->producer) && a->requiresClear == b->requiresClear;
+}
+
+// A matching hash could still be a collision. Reusing a graph of a different structure would record garbage, so everything hashBuilder covers
+// is compared against what the cached graph kept of its builder before reusing it. Attachments of culled passes are not kept and only compared through the hash
+static bool matchesCachedGraph(RenderGraph* graph, RenderGraphBuilder* builder, RenderGraphImageHandle swapchainOutputHandle) {
+    if(graph->buildPassCount != builder->currentPassIndex - 1 || graph->imageCount != builder->currentResourceIndex || graph->bufferCount != builder->currentBufferIndex ||
+        getImageHandleData(graph->finalImageHandle) != getImageHandleData(swapchainOutputHandle) || graph->scheduleMode != builder->scheduleMode ||
+        graph->batchPasses != builder->batchPasses || graph->directSwapchain != canRenderDirectlyToSwapchain(builder, swapchainOutputHandle)) {
+        return false;
+    }
+    for(u32 i = 0; i < graph->buildPassCount; ++i) {
+        struct RenderGraphBuildPass* buildPass = &builder->passes[i];
+        struct RenderGraphBuildPassFlags* flags = &graph->buildPassFlags[i];
+        if(flags->external != buildPass->external || flags->async != buildPass->async || flags->staticPass != buildPass->staticPass || flags->readback != buildPass->readback) {
+            return false;
+        }
+        if(graph->buildPassToSortedPass[i] == UINT16_MAX) {
+            continue;
+        }
+        RenderGraphPass* pass = &graph->sortedPasses[graph->buildPassToSortedPass[i]];
+        if(pass->type != buildPass->type || pass->inputCount != buildPass->inputCount || pass->outputCount != buildPass->outputCount ||
+            pass->bufferInputCount != buildPass->bufferInputCount || pass->bufferOutputCount != buildPass->bufferOutputCount ||
+            pass->secondaryCommandBufferCount != buildPass->secondaryCommandBufferCount || pass->viewMask != buildPass->viewMask || !str8IsEqual(pass->name, buildPass->name)) {
+            return false;
+        }
+        for(u32 j = 0; j < pass->inputCount; ++j) {
+            if(!attachmentsMatch(&pass->inputs[j], &buildPass->inputs[j])) {
+                return false;
+            }
+        }
+        for(u32 j = 0; j < pass->outputCount; ++j) {
+            if(!attachmentsMatch(&pass->outputs[j], &buildPass->outputs[j])) {
+                return false;
+            }
+        }
+        for(u32 j = 0; j < pass->bufferInputCount; ++j) {
+            if(!bufferAttachmentsMatch(&pass->bufferInputs[j], &buildPass->bufferInputs[j])) {
+                return false;
+            }
+        }
+        for(u32 j = 0; j < pass->bufferOutputCount; ++j) {
+            if(!bufferAttachmentsMatch(&pass->bufferOutputs[j], &buildPass->bufferOutputs[j])) {
+                return false;
             }
         }
-        nextPointerLocation = &memoryBlock->next;
-        memoryBlock = memoryBlock->next;
     }
-    if(!memoryBlock) {
-        // Need to allocate a new memory block
-        printf("Allocating new memory block for framebuffers\n");
-        ASSERT(*nextPointerLocation == 0);
-        VkMemoryAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-        allocateInfo.allocationSize = MAX(memoryRequirements.size, MB(256));
-        allocateInfo.memoryTypeIndex = memoryTypeIndex;
-        memoryBlock = ARENA_PUSH_STRUCT(&graph->arena, struct RenderGraphMemoryBlock);
-        vkAllocateMemory(context->device, &allocateInfo, 0, &memoryBlock->memory);
-        memoryBlock->size = allocateInfo.allocationSize;
-        memoryBlock->offset = 0;
-        memoryBlock->type = memoryTypeIndex;
-        // Add to blocks
-        *nextPointerLocation = memoryBlock;
+    for(u32 i = 0; i < graph->imageCount; ++i) {
+        if(!buildImagesMatch(&graph->buildImages[i], &builder->images[i])) {
+            return false;
+        }
     }
-    u64 memoryOffset = ALIGN_UP_POW2(memoryBlock->offset, memoryRequirements.alignment);
-    vkBindImageMemory(context->device, result.image, memoryBlock->memory, memoryOffset);
-    memoryBlock->offset = memoryOffset + memoryRequirements.size;
-
-    { // Create the image view
-        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-        if(isDepthFormat(format)) {
-            aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    for(u32 i = 0; i < graph->bufferCount; ++i) {
+        if(!buildBuffersMatch(&graph->buildBuffers[i], &builder->buffers[i])) {
+            return false;
         }
-		VkImageViewCreateInfo createInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
-		createInfo.image = result.image;
-		createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		createInfo.format = format;
-		createInfo.subresourceRange.aspectMask = aspect;
-		createInfo.subresourceRange.levelCount = 1;
-		createInfo.subresourceRange.layerCount = 1;
-		vkCreateImageView(context->device, &createInfo, 0, &result.view);
-	}
-	result.width = width;
-	result.height = height;
-	result.depth = 1;
-	result.mipCount = 1;
-	result.format = format;
-	result.samples = samples;
-	return result;
+    }
+    return true;
 }
 
-static struct RenderGraphMemoryBlock* copyAndResetMemoryBlockList(MemoryArena* arena, struct RenderGraphMemoryBlock* firstBlock) {
-    struct RenderGraphMemoryBlock* result = 0;
+// Replaces the fingerprint of a handle. A handle value of 0 stays 0 when keepZero is set as it marks an unused handle
+static u32 replaceFingerprint(u32 handle, u32 fingerprint, bool keepZero) {
+    if(keepZero && !handle) {
+        return 0;
+    }
+    return (handle & INVERSE_FINGERPRINT_MASK) | (fingerprint << FINGERPRINT_SHIFT);
+}
 
-    struct RenderGraphMemoryBlock* memoryBlock = firstBlock;
-    struct RenderGraphMemoryBlock** nextPointerLocation = &result;
-    while(memoryBlock) {
-        struct RenderGraphMemoryBlock* newBlock = ARENA_PUSH_STRUCT_NO_CLEAR(arena, struct RenderGraphMemoryBlock);
-        ASSUME(newBlock) {
-            MEMORY_COPY_STRUCT(newBlock, memoryBlock);
-            newBlock->next = 0;
-            newBlock->offset = 0;
-            *nextPointerLocation = newBlock;
-            nextPointerLocation = &newBlock->next;
-            memoryBlock = memoryBlock->next;
+// Static passes are recorded again in every frame slot
+static void invalidateStaticPasses(RenderGraph* graph) {
+    for(u32 i = 0; i < graph->passCount; ++i) {
+        MEMORY_CLEAR(graph->sortedPasses[i].staticRenderScales, sizeof(graph->sortedPasses[i].staticRenderScales));
+    }
+}
+
+// Makes a cached graph usable with handles of a structurally identical builder. No Vulkan objects are touched
+static void remapCachedGraph(RenderGraph* graph, RenderGraphBuilder* builder, RenderGraphImageHandle swapchainOutputHandle) {
+    u32 fingerprint = builder->fingerprint;
+    graph->fingerprint = fingerprint;
+    graph->finalImageHandle = swapchainOutputHandle;
+    if(graph->swapchain) {
+        graph->swapchain = builder->swapchain;
+    }
+    for(u32 passIndex = 0; passIndex < graph->passCount; ++passIndex) {
+        RenderGraphPass* pass = &graph->sortedPasses[passIndex];
+        for(u32 i = 0; i < pass->inputCount + pass->outputCount; ++i) {
+            struct RenderAttachment* attachment = (i < pass->inputCount) ? &pass->inputs[i] : &pass->outputs[i - pass->inputCount];
+            attachment->imageHandle.handle = replaceFingerprint(attachment->imageHandle.handle, fingerprint, false);
+            attachment->producer.handle = replaceFingerprint(attachment->producer.handle, fingerprint, true);
+            attachment->lastReader.handle = replaceFingerprint(attachment->lastReader.handle, fingerprint, true);
+            attachment->resolve.handle = replaceFingerprint(attachment->resolve.handle, fingerprint, true);
+        }
+        for(u32 i = 0; i < pass->bufferInputCount + pass->bufferOutputCount; ++i) {
+            struct RenderBufferAttachment* attachment = (i < pass->bufferInputCount) ? &pass->bufferInputs[i] : &pass->bufferOutputs[i - pass->bufferInputCount];
+            attachment->bufferHandle.handle = replaceFingerprint(attachment->bufferHandle.handle, fingerprint, false);
+            attachment->producer.handle = replaceFingerprint(attachment->producer.handle, fingerprint, true);
         }
     }
 
-    return result;
+    // Clear values are not part of the hash so they can change every frame. Static passes might have recorded the old ones
+    bool clearValuesChanged = false;
+    for(u32 i = 0; i < graph->imageCount; ++i) {
+        clearValuesChanged |= memcmp(&graph->clearValues[i], &builder->images[i].clearColor, sizeof(VkClearValue)) != 0;
+        graph->clearValues[i] = builder->images[i].clearColor;
+        builder->images[i].image = graph->images[i];
+    }
+    for(u32 i = 0; i < graph->bufferCount; ++i) {
+        clearValuesChanged |= graph->bufferClearValues[i] != builder->buffers[i].clearValue;
+        graph->bufferClearValues[i] = builder->buffers[i].clearValue;
+    }
+    if(clearValuesChanged) {
+        invalidateStaticPasses(graph);
+    }
+}
+
+// Fills the command buffer array of every frame slot. Command buffers of the old array keep their index in the slot and only the missing ones are allocated
+static void growCommandBuffers(StromboliContext* context, VkCommandPool* commandPools, VkCommandBuffer* commandBuffers, u32 countPerFrame, VkCommandBuffer* oldCommandBuffers, u32 oldCountPerFrame) {
+    ASSERT(countPerFrame >= oldCountPerFrame);
+    for(u32 slot = 0; slot < RENDER_GRAPH_FRAMES_IN_FLIGHT; ++slot) {
+        if(oldCountPerFrame) {
+            MEMORY_COPY(commandBuffers + slot * countPerFrame, oldCommandBuffers + slot * oldCountPerFrame, sizeof(VkCommandBuffer) * oldCountPerFrame);
+        }
+        if(countPerFrame > oldCountPerFrame) {
+            VkCommandBufferAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocateInfo.commandPool = commandPools[slot];
+            allocateInfo.commandBufferCount = countPerFrame - oldCountPerFrame;
+            vkAllocateCommandBuffers(context->device, &allocateInfo, commandBuffers + slot * countPerFrame + oldCountPerFrame);
+        }
+    }
 }
 
 RenderGraph* renderGraphCompile(RenderGraphBuilder* builder, RenderGraphImageHandle swapchainOutputHandle, RenderGraph* oldGraph) {
     // We can use the builder arena as scratch here
     MemoryArena* scratch = builder->arena;
 
+    u64 builderHash = hashBuilder(builder, swapchainOutputHandle);
+    if(oldGraph && oldGraph->passCount && oldGraph->builderHash == builderHash && matchesCachedGraph(oldGraph, builder, swapchainOutputHandle)) {
+        // Same structure as the old graph so we can skip the whole compilation. Only relative images have to follow a new output size
+        if(builder->outputWidth && (builder->outputWidth != oldGraph->outputWidth || builder->outputHeight != oldGraph->outputHeight)) {
+            renderGraphResize(oldGraph, builder->outputWidth, builder->outputHeight);
+        }
+        remapCachedGraph(oldGraph, builder, swapchainOutputHandle);
+        return oldGraph;
+    }
+
     VkCommandBuffer* oldCommandBuffers = 0;
     u32 oldCommandBufferCountPerFrame = 0;
-    StromboliImage* imageDeleteQueue = 0;
-    u32 imageDeleteCount = 0;
+    VkCommandBuffer* oldAsyncCommandBuffers = 0;
+    VkCommandBuffer* oldStaticCommandBuffers[RENDER_GRAPH_QUEUE_COUNT] = {0};
+    VkSemaphore* oldQueueSemaphores = 0;
+    u32 oldQueueSemaphoreCount = 0;
+    VkEvent* oldEvents = 0;
+    u32 oldEventCount = 0;
+    StromboliBuffer* bufferDeleteQueue = 0;
+    u32 bufferDeleteCount = 0;
+    struct RenderGraphRetiredResource* retiredResources = 0;
+    u32 retiredResourceCount = 0;
+    VkImageView* viewDeleteQueue = 0;
+    u32 viewDeleteCount = 0;
+    StromboliImage* pooledImages = 0;
+    struct RenderGraphImagePlacement* pooledPlacements = 0;
+    u32 pooledImageCount = 0;
     RenderGraph* result = 0;
     struct RenderGraphMemoryBlock* firstBlock = 0; 
     if(oldGraph) {
         // Move data from old graph to scratch memory
-        oldCommandBuffers = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->commandBufferCountPerFrame*2, VkCommandBuffer);
+        oldCommandBuffers = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->commandBufferCountPerFrame*RENDER_GRAPH_FRAMES_IN_FLIGHT, VkCommandBuffer);
         oldCommandBufferCountPerFrame = oldGraph->commandBufferCountPerFrame;
-        MEMORY_COPY(oldCommandBuffers, oldGraph->commandBuffers, sizeof(VkCommandBuffer) * oldGraph->commandBufferCountPerFrame * 2);
-        // We cannot destroy the images here as they might still be used in rendering!
-        imageDeleteQueue = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->imageCount, StromboliImage);
-        imageDeleteCount = oldGraph->imageCount;
-        MEMORY_COPY(imageDeleteQueue, oldGraph->images, sizeof(StromboliImage) * imageDeleteCount);
-        ASSERT(!oldGraph->imageDeleteCount); // Did you call renderGraphExecute?
+        MEMORY_COPY(oldCommandBuffers, oldGraph->commandBuffers, sizeof(VkCommandBuffer) * oldGraph->commandBufferCountPerFrame * RENDER_GRAPH_FRAMES_IN_FLIGHT);
+        if(oldGraph->asyncCommandBuffers) {
+            oldAsyncCommandBuffers = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->commandBufferCountPerFrame*RENDER_GRAPH_FRAMES_IN_FLIGHT, VkCommandBuffer);
+            MEMORY_COPY(oldAsyncCommandBuffers, oldGraph->asyncCommandBuffers, sizeof(VkCommandBuffer) * oldGraph->commandBufferCountPerFrame * RENDER_GRAPH_FRAMES_IN_FLIGHT);
+        }
+        for(u32 queue = 0; queue < RENDER_GRAPH_QUEUE_COUNT; ++queue) {
+            oldStaticCommandBuffers[queue] = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->staticCommandBufferCounts[queue], VkCommandBuffer);
+            MEMORY_COPY(oldStaticCommandBuffers[queue], oldGraph->staticCommandBuffers[queue], sizeof(VkCommandBuffer) * oldGraph->staticCommandBufferCounts[queue]);
+        }
+        oldQueueSemaphores = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->queueSemaphoreCount, VkSemaphore);
+        oldQueueSemaphoreCount = oldGraph->queueSemaphoreCount;
+        MEMORY_COPY(oldQueueSemaphores, oldGraph->queueSemaphores, sizeof(VkSemaphore) * oldQueueSemaphoreCount);
+        oldEvents = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->eventCount, VkEvent);
+        oldEventCount = oldGraph->eventCount;
+        MEMORY_COPY(oldEvents, oldGraph->events, sizeof(VkEvent) * oldEventCount);
+        // Old images form the pool for the new graph. Unused ones are deleted once they are no longer used in rendering
+        pooledImages = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->imageCount, StromboliImage);
+        pooledPlacements = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->imageCount, struct RenderGraphImagePlacement);
+        pooledImageCount = oldGraph->imageCount;
+        MEMORY_COPY(pooledImages, oldGraph->images, sizeof(StromboliImage) * pooledImageCount);
+        MEMORY_COPY(pooledPlacements, oldGraph->imagePlacements, sizeof(struct RenderGraphImagePlacement) * pooledImageCount);
+        // New images might be placed into memory that pending executions still use. The first accesses of the new graph wait for them,
+        // see imageHeapStages. Resources that are not reused are retired and destroyed once the pending executions have finished
+        retiredResources = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->retiredResourceCount, struct RenderGraphRetiredResource);
+        retiredResourceCount = oldGraph->retiredResourceCount;
+        MEMORY_COPY(retiredResources, oldGraph->retiredResources, sizeof(struct RenderGraphRetiredResource) * retiredResourceCount);
+        // Readback buffers are recreated as well so their pending data is lost
+        bufferDeleteQueue = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->bufferCount + oldGraph->readbackCount * RENDER_GRAPH_READBACK_RING_SIZE, StromboliBuffer);
+        bufferDeleteCount = oldGraph->bufferCount;
+        MEMORY_COPY(bufferDeleteQueue, oldGraph->buffers, sizeof(StromboliBuffer) * bufferDeleteCount);
+        for(u32 i = 0; i < oldGraph->readbackCount; ++i) {
+            for(u32 j = 0; j < RENDER_GRAPH_READBACK_RING_SIZE; ++j) {
+                bufferDeleteQueue[bufferDeleteCount++] = oldGraph->readbacks[i].buffers[j];
+            }
+        }
+        // Subresource views are always recreated as the images they belong to might change
+        viewDeleteQueue = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, oldGraph->subresourceCount, VkImageView);
+        viewDeleteCount = oldGraph->subresourceCount;
+        for(u32 i = 0; i < viewDeleteCount; ++i) {
+            viewDeleteQueue[i] = oldGraph->subresources[i].image.view;
+        }
         firstBlock = copyAndResetMemoryBlockList(scratch, oldGraph->firstBlock);
         arenaResetToMarker(oldGraph->resetMarker);
         result = oldGraph;
@@ -279,6 +2163,7 @@ RenderGraph* renderGraphCompile(RenderGraphBuilder* builder, RenderGraphImageHan
         enableDebugMemoryOverflowDetectForArena(&result->arena);
         #endif
         result->resetMarker = arenaCreateMarker(&result->arena);
+        result->pendingGraphMutex = groundedCreateMutex();
     }
 
     // Result is either cleared or contains the data from oldGraph
@@ -291,26 +2176,67 @@ RenderGraph* renderGraphCompile(RenderGraphBuilder* builder, RenderGraphImageHan
         result->passCount = 0;
         result->images = 0;
         result->imageCount = 0;
+        result->subresources = 0;
+        result->subresourceCount = 0;
+        result->buffers = 0;
+        result->bufferCount = 0;
         result->commandBuffers = 0;
+        result->asyncCommandBuffers = 0;
+        MEMORY_CLEAR(result->staticCommandBuffers, sizeof(result->staticCommandBuffers)); // The counts survive. The command buffers are copied back when allocating
+        result->batches = 0;
+        result->batchCount = 0;
+        result->commandBufferCount = 0;
+        result->queueSemaphores = 0;
+        result->queueSemaphoreCount = 0;
+        result->eventDependencies = 0;
+        result->eventDependencyCount = 0;
+        result->readbacks = 0;
+        result->readbackCount = 0;
+        result->events = 0;
+        result->eventCount = 0;
+        for(u32 i = 0; i < RENDER_GRAPH_FRAMES_IN_FLIGHT; ++i) {
+            result->pendingTimedPassCounts[i] = 0; // Pass timestamps of pending executions do not match the new passes
+        }
         result->fingerprint = builder->fingerprint;
-
-        // Flatten images to array
-        u32 imageCount = 0;
-        struct RenderGraphBuildImage* image = builder->imageSentinel.next;
-        while(image) {
-            image = image->next;
-            imageCount++;
+        result->builderHash = builderHash;
+        result->scheduleMode = builder->scheduleMode;
+        result->batchPasses = builder->batchPasses;
+        result->directSwapchain = canRenderDirectlyToSwapchain(builder, swapchainOutputHandle);
+        result->buildPassFlags = ARENA_PUSH_ARRAY_NO_CLEAR(&result->arena, builder->currentPassIndex - 1, struct RenderGraphBuildPassFlags);
+        for(u32 i = 0; i < builder->currentPassIndex - 1; ++i) {
+            struct RenderGraphBuildPass* buildPass = &builder->passes[i];
+            result->buildPassFlags[i] = (struct RenderGraphBuildPassFlags){buildPass->external, buildPass->async, buildPass->staticPass, buildPass->readback};
         }
+        result->buildImages = ARENA_PUSH_ARRAY_NO_CLEAR(&result->arena, builder->currentResourceIndex, struct RenderGraphBuildImage);
+        MEMORY_COPY(result->buildImages, builder->images, sizeof(struct RenderGraphBuildImage) * builder->currentResourceIndex);
+        result->buildBuffers = ARENA_PUSH_ARRAY_NO_CLEAR(&result->arena, builder->currentBufferIndex, struct RenderGraphBuildBuffer);
+        MEMORY_COPY(result->buildBuffers, builder->buffers, sizeof(struct RenderGraphBuildBuffer) * builder->currentBufferIndex);
+        result->outputWidth = builder->outputWidth;
+        result->outputHeight = builder->outputHeight;
+
+        // Images are already stored in a flat array in the builder
+        u32 imageCount = builder->currentResourceIndex;
         result->images = ARENA_PUSH_ARRAY_NO_CLEAR(&result->arena, imageCount, StromboliImage);
         result->clearValues = ARENA_PUSH_ARRAY_NO_CLEAR(&result->arena, imageCount, VkClearValue);
         //result->requiresClear = ARENA_PUSH_ARRAY(&result->arena, imageCount, bool);
         result->imageCount = imageCount;
-        ASSERT(result->imageCount == builder->currentResourceIndex);
+
+        u32 bufferCount = builder->currentBufferIndex;
+        result->buffers = ARENA_PUSH_ARRAY(&result->arena, bufferCount, StromboliBuffer);
+        result->bufferClearValues = ARENA_PUSH_ARRAY(&result->arena, bufferCount, u32);
+        result->bufferCount = bufferCount;
 
         struct RenderGraphBuildImage* swapchainOutput = getImageFromHandle(builder, swapchainOutputHandle);
         result->finalImageHandle = swapchainOutputHandle;
+        result->swapchain = 0;
+        result->swapchainImageAcquired = false;
         if(swapchainOutput) {
-            swapchainOutput->usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            if(canRenderDirectlyToSwapchain(builder, swapchainOutputHandle)) {
+                swapchainOutput->importedSwapchain = true;
+                result->swapchain = builder->swapchain;
+            } else {
+                swapchainOutput->usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            }
             swapchainOutput->isSwpachainOutput = true;
         }
 
@@ -319,94 +2245,266 @@ RenderGraph* renderGraphCompile(RenderGraphBuilder* builder, RenderGraphImageHan
         }
 
         // Create semaphores if not already existing
-        if(!result->imageAcquireSemaphore) {
+        if(!result->imageAcquireSemaphores[0]) {
             VkSemaphoreCreateInfo createInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-            vkCreateSemaphore(builder->context->device, &createInfo, 0, &result->imageAcquireSemaphore);
+            VkFenceCreateInfo fenceCreateInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+            fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // No execution is pending initially
+            for(u32 i = 0; i < RENDER_GRAPH_FRAMES_IN_FLIGHT; ++i) {
+                vkCreateSemaphore(builder->context->device, &createInfo, 0, &result->imageAcquireSemaphores[i]);
+                vkCreateFence(builder->context->device, &fenceCreateInfo, 0, &result->frameFences[i]);
+                for(u32 queue = 0; queue < RENDER_GRAPH_QUEUE_COUNT; ++queue) {
+                    vkCreateSemaphore(builder->context->device, &createInfo, 0, &result->frameSemaphores[i][queue]);
+                }
+            }
             for(u32 i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
                 vkCreateSemaphore(builder->context->device, &createInfo, 0, &result->imageReleaseSemaphores[i]);
             }
         }
 
-        if(imageDeleteCount) {
-            result->imageDeleteCount = imageDeleteCount;
-            result->imageDeleteQueue = ARENA_PUSH_ARRAY_NO_CLEAR(&result->arena, imageDeleteCount, StromboliImage);
-            MEMORY_COPY(result->imageDeleteQueue, imageDeleteQueue, sizeof(StromboliImage) * imageDeleteCount);
+        // Resources retired earlier keep their execution count so they are not destroyed later than necessary
+        result->retiredResourceCapacity = MAX(64, retiredResourceCount + bufferDeleteCount + viewDeleteCount);
+        result->retiredResources = ARENA_PUSH_ARRAY_NO_CLEAR(&result->arena, result->retiredResourceCapacity, struct RenderGraphRetiredResource);
+        result->retiredResourceCount = retiredResourceCount;
+        MEMORY_COPY(result->retiredResources, retiredResources, sizeof(struct RenderGraphRetiredResource) * retiredResourceCount);
+        for(u32 i = 0; i < bufferDeleteCount; ++i) {
+            retireResource(result, RENDER_GRAPH_RETIRED_BUFFER)->buffer = bufferDeleteQueue[i];
+        }
+        for(u32 i = 0; i < viewDeleteCount; ++i) {
+            retireResource(result, RENDER_GRAPH_RETIRED_VIEW)->view = viewDeleteQueue[i];
         }
 
         // Sort passes
-        result->swapchainOutputPassIndex = getIndexOfPass(builder->passSentinel.next, swapchainOutput->producer);
-        swapchainOutput->producer->external = true;
-        struct RenderGraphBuildPass* firstPass = builder->passSentinel.next;
-        u32 passCount = 0;
-        struct RenderGraphBuildPass* pass = firstPass;
-        while(pass) {
-            pass = pass->next;
-            passCount++;
-        }
+        getPassFromHandle(builder, swapchainOutput->producer)->external = true;
+        getPassFromHandle(builder, swapchainOutput->producer)->async = false; // The final blit and present transition require the graphics queue
+        getPassFromHandle(builder, swapchainOutput->producer)->staticPass = false; // Finished with the current swapchain image or final layout every execution
+        u32 passCount = builder->currentPassIndex - 1;
         sortPasses(builder, passCount, result);
         ASSERT(result->passCount <= passCount);
+        result->swapchainOutputPassIndex = result->buildPassToSortedPass[getPassIndex(swapchainOutput->producer)];
+        ASSERT(result->swapchainOutputPassIndex < result->passCount);
+
+        // Timing history. Passes beyond MAX_TIMED_PASS_COUNT are only part of the total duration
+        if(!result->timingWindow) {
+            result->timingWindow = RENDER_GRAPH_DEFAULT_TIMING_WINDOW;
+        }
+        if(!result->renderScale) {
+            result->renderScale = 1.0f;
+        }
+        result->timedPassCount = MIN(result->passCount, MAX_TIMED_PASS_COUNT);
+        result->passTimingSamples = ARENA_PUSH_ARRAY(&result->arena, result->timedPassCount * result->timingWindow, float);
+        result->timingSampleCount = 0;
+        result->nextTimingSample = 0;
 
         // Create images
-        u32 totalClearCount = 0;
-        image = builder->imageSentinel.next;
+        struct RenderGraphImageLifetime* lifetimes = renderGraphAllocateImages(builder, result, scratch, pooledImages, pooledPlacements, pooledImageCount);
         for(u32 i = 0; i < result->imageCount; ++i) {
-            ASSERT(image->image.width);
-            ASSERT(image->image.height);
-            VkImageUsageFlags usage = image->usage;
-            if(usage <= 3) {
-                // Only transfer usage is not allowed so we add VK_IMAGE_USAGE_SAMPLED_BIT
-                usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
-            }
-            
-            #if 1
-            image->image = renderGraphAllocateFramebuffer(result, builder->context, image->image.width, image->image.height, image->format, usage, image->image.samples);
-            #else
-            image->image = stromboliImageCreate(builder->context, image->image.width, image->image.height, image->format, usage, &(struct StromboliImageParameters) {
-                .sampleCount = image->image.samples,
-            });
-            #endif
-            result->images[result->imageCount-i-1] = image->image;
-            image = image->next;
+            builder->images[i].image = result->images[i];
+        }
+
+        // Attachments selecting a single mip or layer need their own view. Sorting them by image and subresource puts attachments
+        // selecting the same subresource next to each other, so each one gets the index of its view in a single sweep
+        u32 maxSubresourceCount = 0;
+        for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+            maxSubresourceCount += result->sortedPasses[passIndex].inputCount + result->sortedPasses[passIndex].outputCount;
+        }
+        struct RenderAttachment** subresourceAttachments = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, maxSubresourceCount, struct RenderAttachment*);
+        u32* subresourceOrder = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, maxSubresourceCount, u32);
+        u64* subresourceKeys = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, maxSubresourceCount, u64);
+        u32 subresourceAttachmentCount = 0;
+        for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+            RenderGraphPass* pass = &result->sortedPasses[passIndex];
+            for(u32 i = 0; i < pass->inputCount + pass->outputCount; ++i) {
+                struct RenderAttachment* attachment = (i < pass->inputCount) ? &pass->inputs[i] : &pass->outputs[i - pass->inputCount];
+                attachment->subresourceIndex = UINT32_MAX;
+                if(getImageSubresourceData(attachment->imageHandle)) {
+                    subresourceAttachments[subresourceAttachmentCount] = attachment;
+                    subresourceOrder[subresourceAttachmentCount] = subresourceAttachmentCount;
+                    subresourceKeys[subresourceAttachmentCount] = getSubresourceKey(attachment->imageHandle);
+                    subresourceAttachmentCount++;
+                }
+            }
+        }
+        sortImagesByKey(subresourceOrder, subresourceKeys, subresourceAttachmentCount, scratch);
+        result->subresources = ARENA_PUSH_ARRAY(&result->arena, subresourceAttachmentCount, struct RenderGraphSubresource);
+        for(u32 k = 0; k < subresourceAttachmentCount; ++k) {
+            u32 j = subresourceOrder[k];
+            if(k == 0 || subresourceKeys[j] != subresourceKeys[subresourceOrder[k-1]]) {
+                struct RenderGraphSubresource* subresource = &result->subresources[result->subresourceCount++];
+                subresource->handle = subresourceAttachments[j]->imageHandle;
+                subresource->handle.handle &= INVERSE_FINGERPRINT_MASK;
+            }
+            subresourceAttachments[j]->subresourceIndex = result->subresourceCount - 1;
+        }
+        renderGraphCreateSubresourceViews(result, builder->context, 0);
+
+        // Create buffers
+        for(u32 i = 0; i < result->bufferCount; ++i) {
+            struct RenderGraphBuildBuffer* buffer = &builder->buffers[i];
+            ASSERT(buffer->size);
+            VkBufferUsageFlags usage = buffer->usage;
+            if(!usage) {
+                usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            }
+            result->buffers[i] = renderGraphAllocateBuffer(result, builder->context, buffer->size, usage);
+        }
+
+        // Create readback rings
+        for(u32 i = 0; i < result->buildPassCount; ++i) {
+            if(builder->passes[i].readback && result->buildPassToSortedPass[i] != UINT16_MAX) {
+                result->readbackCount++;
+            }
+        }
+        result->readbacks = ARENA_PUSH_ARRAY(&result->arena, result->readbackCount, struct RenderGraphReadback);
+        u32 readbackIndex = 0;
+        for(u32 i = 0; i < result->buildPassCount; ++i) {
+            if(!builder->passes[i].readback || result->buildPassToSortedPass[i] == UINT16_MAX) {
+                continue;
+            }
+            RenderGraphPass* pass = &result->sortedPasses[result->buildPassToSortedPass[i]];
+            struct RenderGraphReadback* readback = &result->readbacks[readbackIndex++];
+            pass->readback = readback;
+            readback->buildPassIndex = i;
+            readback->imageIndex = getImageHandleData(pass->inputs[0].imageHandle);
+            readback->blitSourceIndex = UINT32_MAX;
+            if(pass->outputCount) {
+                readback->blitSourceIndex = readback->imageIndex;
+                readback->imageIndex = getImageHandleData(pass->outputs[0].imageHandle);
+            }
+            readback->texelSize = getTexelCopySize(result->images[readback->imageIndex].format);
+            ASSERT(readback->texelSize); // Format is not supported for readbacks
+            createReadbackBuffers(builder->context, readback, &result->images[readback->imageIndex]);
         }
 
         // Create barriers
+        u32 totalClearCount = 0;
+        for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+            RenderGraphPass* pass = &result->sortedPasses[passIndex];
+            for(u32 i = 0; i < pass->outputCount; ++i) {
+                if(pass->outputs[i].requiresClear && pass->type != RENDER_GRAPH_PASS_TYPE_GRAPHICS) {
+                    totalClearCount++;
+                }
+            }
+        }
         VkImageMemoryBarrier2KHR* totalClearBarriers = ARENA_PUSH_ARRAY(&result->arena, totalClearCount, VkImageMemoryBarrier2KHR);
         u32 totalClearBarrierIndex = 0;
+        // Every subresource has its own state so accesses of different mips or layers do not wait for each other
+        u32* firstImageStates = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, result->imageCount, u32);
+        u32 imageStateCount = 0;
+        for(u32 i = 0; i < result->imageCount; ++i) {
+            firstImageStates[i] = imageStateCount;
+            imageStateCount += result->images[i].mipCount * result->imagePlacements[i].layerCount;
+        }
+        struct RenderGraphResourceState* imageStates = ARENA_PUSH_ARRAY(scratch, imageStateCount, struct RenderGraphResourceState);
+        bool** redundantImageBarriers = ARENA_PUSH_ARRAY(scratch, result->passCount, bool*);
+        u32** imageEventPasses = ARENA_PUSH_ARRAY(scratch, result->passCount, u32*);
         for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
             RenderGraphPass* pass = &result->sortedPasses[passIndex];
+            // Inputs whose subresources are in different layouts need one barrier per subresource. The additional ones follow the output barriers
+            u32 maxSubresourceBarrierCount = 0;
+            for(u32 i = 0; i < pass->inputCount; ++i) {
+                VkImageSubresourceRange range = getAttachmentRange(result, pass->inputs[i].imageHandle);
+                maxSubresourceBarrierCount += range.levelCount * range.layerCount - 1;
+            }
+            VkImageMemoryBarrier2KHR* subresourceBarriers = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, maxSubresourceBarrierCount, VkImageMemoryBarrier2KHR);
+            u32 subresourceBarrierCount = 0;
             pass->afterClearBarriers = &totalClearBarriers[totalClearBarrierIndex];
-            pass->imageBarriers = ARENA_PUSH_ARRAY(&result->arena, pass->inputCount + pass->outputCount, VkImageMemoryBarrier2KHR);
+            pass->imageBarriers = ARENA_PUSH_ARRAY(&result->arena, pass->inputCount + pass->outputCount + maxSubresourceBarrierCount, VkImageMemoryBarrier2KHR);
+            redundantImageBarriers[passIndex] = ARENA_PUSH_ARRAY(scratch, pass->inputCount + pass->outputCount, bool);
+            imageEventPasses[passIndex] = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, pass->inputCount, u32);
+            // Every input gets a barrier slot as scheduleQueues expects them in input order. Unneeded ones are removed after scheduling
             for(u32 i = 0; i < pass->inputCount; ++i) {
                 struct RenderAttachment inputAttachment = pass->inputs[i];
-                RenderGraphImage* inputImage = getImageFromHandle(builder, inputAttachment.imageHandle);
-                struct RenderGraphBuildPass* producer = inputAttachment.producer;
-                ASSERT(producer);
-
-                struct RenderAttachment outputAttachment = {0};
-                for(u32 j = 0; j < producer->outputCount; ++j) {
-                    if(producer->outputs[j].imageHandle.handle == inputAttachment.imageHandle.handle) {
-                        outputAttachment = producer->outputs[j];
+                u32 imageIndex = getImageHandleData(inputAttachment.imageHandle);
+                u32 layerCount = result->imagePlacements[imageIndex].layerCount;
+                VkImageSubresourceRange range = getAttachmentRange(result, inputAttachment.imageHandle);
+                struct RenderGraphResourceState* firstState = &imageStates[firstImageStates[imageIndex] + range.baseMipLevel * layerCount + range.baseArrayLayer];
+                VkImageLayout oldLayout = firstState->layout;
+                bool sameLayout = true;
+                bool sameBarrier = true;
+                for(u32 mip = range.baseMipLevel; mip < range.baseMipLevel + range.levelCount; ++mip) {
+                    for(u32 layer = range.baseArrayLayer; layer < range.baseArrayLayer + range.layerCount; ++layer) {
+                        struct RenderGraphResourceState* state = &imageStates[firstImageStates[imageIndex] + mip * layerCount + layer];
+                        sameLayout &= state->layout == oldLayout;
+                        sameBarrier &= state->barrierPass == firstState->barrierPass && state->barrierIndex == firstState->barrierIndex;
+                    }
+                }
+                bool writtenByPass = false;
+                for(u32 j = 0; j < pass->outputCount; ++j) {
+                    if(imageHandlesOverlap(pass->outputs[j].imageHandle, inputAttachment.imageHandle)) {
+                        writtenByPass = true;
                     }
                 }
 
-                if(inputImage->isSwpachainOutput) {
-                    pass->imageBarriers[pass->imageBarrierCount++] = stromboliCreateImageBarrier(result->images[getImageHandleData(inputAttachment.imageHandle)].image, 
-                        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                        inputAttachment.stage, inputAttachment.access, inputAttachment.layout);
-                } else {
-                    pass->imageBarriers[pass->imageBarrierCount++] = stromboliCreateImageBarrier(result->images[getImageHandleData(inputAttachment.imageHandle)].image, 
-                        outputAttachment.stage, outputAttachment.access, outputAttachment.layout,
-                        inputAttachment.stage, inputAttachment.access, inputAttachment.layout);
+                // Subresources in the same layout share one barrier that waits for all of them
+                VkPipelineStageFlags2 srcStage = 0;
+                VkAccessFlags2 srcAccess = 0;
+                bool required = false;
+                imageEventPasses[passIndex][i] = 0;
+                u32 barrierPass = firstState->barrierPass;
+                u32 barrierIndex = firstState->barrierIndex;
+                for(u32 mip = range.baseMipLevel; mip < range.baseMipLevel + range.levelCount; ++mip) {
+                    for(u32 layer = range.baseArrayLayer; layer < range.baseArrayLayer + range.layerCount; ++layer) {
+                        struct RenderGraphResourceState* state = &imageStates[firstImageStates[imageIndex] + mip * layerCount + layer];
+                        VkPipelineStageFlags2 subresourceStage = 0;
+                        VkAccessFlags2 subresourceAccess = 0;
+                        u32 eventPass = 0;
+                        VkImageLayout subresourceLayout = state->layout;
+                        bool subresourceRequired = syncResourceRead(state, inputAttachment.layout, inputAttachment.stage, inputAttachment.access, writtenByPass, pass, passIndex, &subresourceStage, &subresourceAccess, &eventPass);
+                        if(sameLayout || state == firstState) {
+                            srcStage |= subresourceStage;
+                            srcAccess |= subresourceAccess;
+                            required |= subresourceRequired;
+                            if(eventPass == UINT32_MAX || imageEventPasses[passIndex][i] == UINT32_MAX) {
+                                imageEventPasses[passIndex][i] = UINT32_MAX;
+                            } else {
+                                imageEventPasses[passIndex][i] = MAX(imageEventPasses[passIndex][i], eventPass);
+                            }
+                        } else if(subresourceRequired) {
+                            // Queue ownership transfers are only applied to the first barrier of an input
+                            ASSERT(!lifetimes[imageIndex].usedOnAsyncQueue);
+                            VkImageMemoryBarrier2KHR* barrier = &subresourceBarriers[subresourceBarrierCount++];
+                            *barrier = stromboliCreateImageBarrier(result->images[imageIndex].image,
+                                subresourceStage, subresourceAccess, subresourceLayout,
+                                inputAttachment.stage, inputAttachment.access, inputAttachment.layout);
+                            barrier->subresourceRange = getAttachmentRange(result, inputAttachment.imageHandle);
+                            barrier->subresourceRange.baseMipLevel = mip;
+                            barrier->subresourceRange.levelCount = 1;
+                            barrier->subresourceRange.baseArrayLayer = layer;
+                            barrier->subresourceRange.layerCount = 1;
+                        }
+                    }
                 }
-                if(isDepthFormat(result->images[getImageHandleData(inputAttachment.imageHandle)].format)) {
-                    pass->imageBarriers[pass->imageBarrierCount-1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+                if(!sameLayout) {
+                    range.levelCount = 1;
+                    range.layerCount = 1;
+                }
+
+                pass->imageBarriers[pass->imageBarrierCount++] = stromboliCreateImageBarrier(result->images[imageIndex].image, 
+                    srcStage, srcAccess, oldLayout,
+                    inputAttachment.stage, inputAttachment.access, inputAttachment.layout);
+                pass->imageBarriers[pass->imageBarrierCount-1].subresourceRange = range;
+                if(!required) {
+                    redundantImageBarriers[passIndex][i] = true;
+                } else if(sameLayout && sameBarrier && barrierPass == passIndex && pass->imageBarriers[barrierIndex].newLayout == inputAttachment.layout) {
+                    // Same subresources are used multiple times by this pass. Extend the first barrier instead
+                    pass->imageBarriers[barrierIndex].dstStageMask |= inputAttachment.stage;
+                    pass->imageBarriers[barrierIndex].dstAccessMask |= inputAttachment.access;
+                    redundantImageBarriers[passIndex][i] = true;
+                } else {
+                    for(u32 mip = range.baseMipLevel; mip < range.baseMipLevel + range.levelCount; ++mip) {
+                        for(u32 layer = range.baseArrayLayer; layer < range.baseArrayLayer + range.layerCount; ++layer) {
+                            struct RenderGraphResourceState* state = &imageStates[firstImageStates[imageIndex] + mip * layerCount + layer];
+                            state->barrierPass = passIndex;
+                            state->barrierIndex = i;
+                        }
+                    }
                 }
             }
             for(u32 i = 0; i < pass->outputCount; ++i) {
                 struct RenderAttachment outputAttachment = pass->outputs[i];
                 bool usedAsInput = false;
                 for(u32 j = 0; j < pass->inputCount; ++j) {
-                    if(pass->inputs[j].imageHandle.handle == pass->outputs[i].imageHandle.handle) {
+                    if(imageHandlesOverlap(pass->inputs[j].imageHandle, pass->outputs[i].imageHandle)) {
                         usedAsInput = true;
                     }
                 }
@@ -415,51 +2513,272 @@ RenderGraph* renderGraphCompile(RenderGraphBuilder* builder, RenderGraphImageHan
                     continue;
                 }
                 RenderGraphImage* outputImage = getImageFromHandle(builder, outputAttachment.imageHandle);
+                if(outputImage->importedSwapchain) {
+                    // Recorded once the swapchain image is known
+                    if(pass->outputs[i].requiresClear) {
+                        result->clearValues[getImageHandleData(pass->outputs[i].imageHandle)] = outputImage->clearColor;
+                    }
+                    continue;
+                }
+                // This is the first use of the image. We have to wait for the last accesses of previous images in the same memory,
+                // which includes the previous execution if no earlier image of this execution used the memory
+                struct RenderGraphImageLifetime* lifetime = &lifetimes[getImageHandleData(outputAttachment.imageHandle)];
+                VkPipelineStageFlags2 aliasStage = lifetime->aliasStage;
+                VkAccessFlags2 aliasAccess = lifetime->aliasAccess;
+                restrictFirstAccessScope(pass->queue, outputAttachment.stage, &aliasStage, &aliasAccess);
+                VkImageSubresourceRange range = getAttachmentRange(result, outputAttachment.imageHandle);
                 if(pass->outputs[i].requiresClear) {
                     result->clearValues[getImageHandleData(pass->outputs[i].imageHandle)] = outputImage->clearColor;
                 }
                 if(pass->outputs[i].requiresClear && pass->type != RENDER_GRAPH_PASS_TYPE_GRAPHICS) {
                     // We need barriers for an intermediate clear call
                     pass->imageBarriers[pass->imageBarrierCount++] = stromboliCreateImageBarrier(result->images[getImageHandleData(outputAttachment.imageHandle)].image, 
-                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 
+                        aliasStage, aliasAccess, VK_IMAGE_LAYOUT_UNDEFINED, 
                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
-                    if(isDepthFormat(result->images[getImageHandleData(outputAttachment.imageHandle)].format)) {
-                        pass->imageBarriers[pass->imageBarrierCount-1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-                    }
+                    pass->imageBarriers[pass->imageBarrierCount-1].subresourceRange = range;
 
                     VkImageMemoryBarrier2KHR afterClearBarrier = stromboliCreateImageBarrier(result->images[getImageHandleData(outputAttachment.imageHandle)].image,
                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
                         outputAttachment.stage, outputAttachment.access, outputAttachment.layout);
-                    if(isDepthFormat(result->images[getImageHandleData(outputAttachment.imageHandle)].format)) {
-                        afterClearBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-                    }
+                    afterClearBarrier.subresourceRange = range;
                     totalClearBarriers[totalClearBarrierIndex++] = afterClearBarrier;
                     pass->afterClearBarrierCount++;
                 } else {
                     // We do not clear so we can transition from undefined and ignore previous content
                     pass->imageBarriers[pass->imageBarrierCount++] = stromboliCreateImageBarrier(result->images[getImageHandleData(outputAttachment.imageHandle)].image, 
-                        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 
+                        aliasStage, aliasAccess, VK_IMAGE_LAYOUT_UNDEFINED, 
                         outputAttachment.stage, outputAttachment.access, outputAttachment.layout);
-                    if(isDepthFormat(result->images[getImageHandleData(outputAttachment.imageHandle)].format)) {
-                        pass->imageBarriers[pass->imageBarrierCount-1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+                    pass->imageBarriers[pass->imageBarrierCount-1].subresourceRange = range;
+                }
+            }
+            MEMORY_COPY(&pass->imageBarriers[pass->imageBarrierCount], subresourceBarriers, sizeof(VkImageMemoryBarrier2KHR) * subresourceBarrierCount);
+            pass->imageBarrierCount += subresourceBarrierCount;
+
+            // Writes of this pass are what following passes have to wait for
+            for(u32 i = 0; i < pass->outputCount; ++i) {
+                struct RenderAttachment outputAttachment = pass->outputs[i];
+                u32 imageIndex = getImageHandleData(outputAttachment.imageHandle);
+                u32 layerCount = result->imagePlacements[imageIndex].layerCount;
+                VkImageSubresourceRange range = getAttachmentRange(result, outputAttachment.imageHandle);
+                for(u32 mip = range.baseMipLevel; mip < range.baseMipLevel + range.levelCount; ++mip) {
+                    for(u32 layer = range.baseArrayLayer; layer < range.baseArrayLayer + range.layerCount; ++layer) {
+                        resetResourceState(&imageStates[firstImageStates[imageIndex] + mip * layerCount + layer], outputAttachment.layout, outputAttachment.stage, outputAttachment.access, pass, passIndex);
                     }
                 }
             }
+            if(passIndex == result->swapchainOutputPassIndex) {
+                // The final blit reads mip 0 of layer 0 at the end of this pass
+                struct RenderGraphResourceState* state = &imageStates[firstImageStates[getImageHandleData(swapchainOutputHandle)]];
+                resetResourceState(state, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, pass, passIndex);
+                state->readStages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            }
         }
         ASSERT(totalClearBarrierIndex <= totalClearCount);
 
+        // Derive load and store ops. Contents that were never written before are not loaded and contents nobody reads afterwards are not stored
+        for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+            RenderGraphPass* pass = &result->sortedPasses[passIndex];
+            if(pass->type != RENDER_GRAPH_PASS_TYPE_GRAPHICS) {
+                continue;
+            }
+            for(u32 i = 0; i < pass->outputCount; ++i) {
+                struct RenderAttachment* output = &pass->outputs[i];
+                struct RenderGraphImageLifetime* lifetime = &lifetimes[getImageHandleData(output->imageHandle)];
+                if(getImageFromHandle(builder, output->imageHandle)->importedSwapchain) {
+                    // Only written by this pass and presented afterwards
+                    output->loadOp = output->requiresClear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                    output->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                    continue;
+                }
+
+                if(output->requiresClear) {
+                    output->loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                } else if(lifetime->firstPass < passIndex) {
+                    output->loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+                } else {
+                    // First use. The image was transitioned from undefined anyway
+                    output->loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                }
+
+                // Outputs of external passes and images shared with the async queue live until the end of the graph so they are always stored
+                VkAccessFlags writeAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                if(output->access && !(output->access & writeAccess) && !output->requiresClear) {
+                    // The pass only reads the attachment so the content stays as it is. Part of VK_KHR_dynamic_rendering
+                    output->storeOp = VK_ATTACHMENT_STORE_OP_NONE_KHR;
+                } else if(lifetime->lastPass > passIndex) {
+                    output->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                } else {
+                    output->storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                }
+            }
+        }
+
+        // Last accesses of every buffer. Buffers are shared by all executions so the first access of the next execution has to wait for them.
+        // After a recompilation the buffers reuse the memory of the old ones so the first execution also waits for those
+        VkPipelineStageFlags2 previousBufferStages = result->bufferMemoryStages;
+        VkAccessFlags2 previousBufferAccesses = result->bufferMemoryAccesses;
+        result->bufferMemoryStages = 0;
+        result->bufferMemoryAccesses = 0;
+        VkPipelineStageFlags2* bufferLastStages = ARENA_PUSH_ARRAY(scratch, result->bufferCount, VkPipelineStageFlags2);
+        VkAccessFlags2* bufferLastAccesses = ARENA_PUSH_ARRAY(scratch, result->bufferCount, VkAccessFlags2);
+        u32* bufferLastPasses = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, result->bufferCount, u32);
+        bool* bufferAccessed = ARENA_PUSH_ARRAY(scratch, result->bufferCount, bool);
+        for(u32 i = 0; i < result->bufferCount; ++i) {
+            bufferLastPasses[i] = UINT32_MAX;
+        }
+        for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+            RenderGraphPass* pass = &result->sortedPasses[passIndex];
+            for(u32 i = 0; i < pass->bufferInputCount + pass->bufferOutputCount; ++i) {
+                struct RenderBufferAttachment* attachment = (i < pass->bufferInputCount) ? &pass->bufferInputs[i] : &pass->bufferOutputs[i - pass->bufferInputCount];
+                u32 bufferIndex = getBufferHandleData(attachment->bufferHandle);
+                if(bufferLastPasses[bufferIndex] != passIndex) {
+                    bufferLastStages[bufferIndex] = 0;
+                    bufferLastAccesses[bufferIndex] = 0;
+                }
+                bufferLastPasses[bufferIndex] = passIndex;
+                bufferLastStages[bufferIndex] |= attachment->stage;
+                bufferLastAccesses[bufferIndex] |= attachment->access;
+            }
+        }
+        for(u32 i = 0; i < result->bufferCount; ++i) {
+            result->bufferMemoryStages |= bufferLastStages[i];
+            result->bufferMemoryAccesses |= bufferLastAccesses[i];
+        }
+
+        // Create buffer barriers. One per input in input order followed by the first accesses of the execution, which are always outputs
+        struct RenderGraphResourceState* bufferStates = ARENA_PUSH_ARRAY(scratch, result->bufferCount, struct RenderGraphResourceState);
+        bool** redundantBufferBarriers = ARENA_PUSH_ARRAY(scratch, result->passCount, bool*);
+        u32** bufferEventPasses = ARENA_PUSH_ARRAY(scratch, result->passCount, u32*);
+        for(u32 passIndex = 0; passIndex < result->passCount; ++passIndex) {
+            RenderGraphPass* pass = &result->sortedPasses[passIndex];
+            pass->bufferBarriers = ARENA_PUSH_ARRAY(&result->arena, pass->bufferInputCount + pass->bufferOutputCount, VkBufferMemoryBarrier2KHR);
+            pass->afterClearBufferBarriers = ARENA_PUSH_ARRAY(&result->arena, pass->bufferOutputCount, VkBufferMemoryBarrier2KHR);
+            redundantBufferBarriers[passIndex] = ARENA_PUSH_ARRAY(scratch, pass->bufferInputCount + pass->bufferOutputCount, bool);
+            bufferEventPasses[passIndex] = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, pass->bufferInputCount + pass->bufferOutputCount, u32);
+            for(u32 i = 0; i < pass->bufferInputCount; ++i) {
+                struct RenderBufferAttachment inputAttachment = pass->bufferInputs[i];
+                struct RenderGraphResourceState* state = &bufferStates[getBufferHandleData(inputAttachment.bufferHandle)];
+                bool writtenByPass = false;
+                for(u32 j = 0; j < pass->bufferOutputCount; ++j) {
+                    if(pass->bufferOutputs[j].bufferHandle.handle == inputAttachment.bufferHandle.handle) {
+                        writtenByPass = true;
+                    }
+                }
+
+                VkPipelineStageFlags2 srcStage = 0;
+                VkAccessFlags2 srcAccess = 0;
+                bool required = syncResourceRead(state, VK_IMAGE_LAYOUT_UNDEFINED, inputAttachment.stage, inputAttachment.access, writtenByPass, pass, passIndex, &srcStage, &srcAccess, &bufferEventPasses[passIndex][i]);
+                pass->bufferBarriers[pass->bufferBarrierCount++] = (VkBufferMemoryBarrier2KHR) {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+                    .srcStageMask = srcStage,
+                    .srcAccessMask = srcAccess,
+                    .dstStageMask = inputAttachment.stage,
+                    .dstAccessMask = inputAttachment.access,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .buffer = result->buffers[getBufferHandleData(inputAttachment.bufferHandle)].buffer,
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE,
+                };
+                if(!required) {
+                    redundantBufferBarriers[passIndex][i] = true;
+                } else if(state->barrierPass == passIndex) {
+                    pass->bufferBarriers[state->barrierIndex].dstStageMask |= inputAttachment.stage;
+                    pass->bufferBarriers[state->barrierIndex].dstAccessMask |= inputAttachment.access;
+                    redundantBufferBarriers[passIndex][i] = true;
+                } else {
+                    state->barrierPass = passIndex;
+                    state->barrierIndex = i;
+                }
+            }
+            for(u32 i = 0; i < pass->bufferOutputCount; ++i) {
+                struct RenderBufferAttachment outputAttachment = pass->bufferOutputs[i];
+                resetResourceState(&bufferStates[getBufferHandleData(outputAttachment.bufferHandle)], VK_IMAGE_LAYOUT_UNDEFINED, outputAttachment.stage, outputAttachment.access, pass, passIndex);
+            }
+            for(u32 i = 0; i < pass->bufferOutputCount; ++i) {
+                struct RenderBufferAttachment outputAttachment = pass->bufferOutputs[i];
+                u32 bufferIndex = getBufferHandleData(outputAttachment.bufferHandle);
+                if(!bufferAccessed[bufferIndex]) {
+                    // The content does not matter but the write must not overtake the accesses of the previous execution. The clear is the first write
+                    VkPipelineStageFlags2 dstStage = outputAttachment.requiresClear ? VK_PIPELINE_STAGE_TRANSFER_BIT : outputAttachment.stage;
+                    VkAccessFlags2 dstAccess = outputAttachment.requiresClear ? VK_ACCESS_TRANSFER_WRITE_BIT : outputAttachment.access;
+                    VkPipelineStageFlags2 srcStage = bufferLastStages[bufferIndex] | previousBufferStages;
+                    VkAccessFlags2 srcAccess = bufferLastAccesses[bufferIndex] | previousBufferAccesses;
+                    restrictFirstAccessScope(pass->queue, dstStage, &srcStage, &srcAccess);
+                    bufferEventPasses[passIndex][pass->bufferBarrierCount] = UINT32_MAX;
+                    pass->bufferBarriers[pass->bufferBarrierCount++] = (VkBufferMemoryBarrier2KHR) {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+                        .srcStageMask = srcStage,
+                        .srcAccessMask = srcAccess,
+                        .dstStageMask = dstStage,
+                        .dstAccessMask = dstAccess,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .buffer = result->buffers[bufferIndex].buffer,
+                        .offset = 0,
+                        .size = VK_WHOLE_SIZE,
+                    };
+                }
+                bufferAccessed[bufferIndex] = true;
+                if(outputAttachment.requiresClear) {
+                    RenderGraphBuffer* outputBuffer = getBufferFromHandle(builder, outputAttachment.bufferHandle);
+                    result->bufferClearValues[getBufferHandleData(outputAttachment.bufferHandle)] = outputBuffer->clearValue;
+                    pass->afterClearBufferBarriers[pass->afterClearBufferBarrierCount++] = (VkBufferMemoryBarrier2KHR) {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+                        .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                        .dstStageMask = outputAttachment.stage,
+                        .dstAccessMask = outputAttachment.access,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .buffer = result->buffers[getBufferHandleData(outputAttachment.bufferHandle)].buffer,
+                        .offset = 0,
+                        .size = VK_WHOLE_SIZE,
+                    };
+                }
+            }
+        }
+
         // Create swapchain barrier
-        struct RenderGraphBuildPass* producer = swapchainOutput->producer;
-        result->swapchainOutputPassIndex = result->passCount - getIndexOfPass(builder->passSentinel.next, producer) - 1;
+        struct RenderGraphBuildPass* producer = getPassFromHandle(builder, swapchainOutput->producer);
         struct RenderAttachment outputAttachment = {0};
         for(u32 j = 0; j < producer->outputCount; ++j) {
             if(producer->outputs[j].imageHandle.handle == swapchainOutputHandle.handle) {
                 outputAttachment = producer->outputs[j];
             }
         }
-        result->finalImageBarrier = stromboliCreateImageBarrier(result->images[getImageHandleData(swapchainOutputHandle)].image, 
-            outputAttachment.stage, outputAttachment.access, outputAttachment.layout, 
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        if(result->swapchain) {
+            // Synchronizes with the acquire semaphore which is waited for at the color attachment output stage
+            result->finalImageBarrier = stromboliCreateImageBarrier(0, 
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 
+                outputAttachment.stage, outputAttachment.access, outputAttachment.layout);
+            result->presentBarrier = stromboliCreateImageBarrier(0, 
+                outputAttachment.stage, outputAttachment.access, outputAttachment.layout, 
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        } else {
+            result->finalImageBarrier = stromboliCreateImageBarrier(result->images[getImageHandleData(swapchainOutputHandle)].image, 
+                outputAttachment.stage, outputAttachment.access, outputAttachment.layout, 
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        }
+
+        // Distribute passes onto queues
+        scheduleQueues(builder, result, scratch, oldQueueSemaphores, oldQueueSemaphoreCount);
+        removeRedundantBarriers(result, redundantImageBarriers, redundantBufferBarriers, imageEventPasses, bufferEventPasses);
+
+        // Events are set and waited within one execution. Every frame slot needs its own set as the previous execution might still use them
+        result->eventCount = MAX(result->eventDependencyCount * RENDER_GRAPH_FRAMES_IN_FLIGHT, oldEventCount);
+        result->events = ARENA_PUSH_ARRAY(&result->arena, result->eventCount, VkEvent);
+        MEMORY_COPY(result->events, oldEvents, sizeof(VkEvent) * oldEventCount);
+        for(u32 i = oldEventCount; i < result->eventCount; ++i) {
+            VkEventCreateInfo createInfo = {VK_STRUCTURE_TYPE_EVENT_CREATE_INFO};
+            vkCreateEvent(builder->context->device, &createInfo, 0, &result->events[i]);
+        }
+        bool usesAsyncQueue = false;
+        for(u32 i = 0; i < result->batchCount; ++i) {
+            if(result->batches[i].queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE) {
+                usesAsyncQueue = true;
+            }
+        }
 
         // Create command pools if not existing
         if(!result->commandPools[0]) {
@@ -483,31 +2802,71 @@ RenderGraph* renderGraphCompile(RenderGraphBuilder* builder, RenderGraphImageHan
         // Allocate commandbuffers
         result->commandBufferCountPerFrame = MAX(result->passCount, oldCommandBufferCountPerFrame);
         ASSERT(result->commandBufferCountPerFrame >= result->passCount);
-        result->commandBuffers = ARENA_PUSH_ARRAY(&result->arena, result->commandBufferCountPerFrame * 2, VkCommandBuffer);
-        
-        if(result->commandBufferCountPerFrame == oldCommandBufferCountPerFrame) {
-            // We have the exact same number of passes. This means we can just reuse the old command buffers as is
-            MEMORY_COPY(result->commandBuffers, oldCommandBuffers, sizeof(VkCommandBuffer) * oldCommandBufferCountPerFrame * 2);
-        } else if(result->commandBufferCountPerFrame < oldCommandBufferCountPerFrame) {
-            // Should not happen as new scheme only grows!
-            ASSERT(false);
-        } else {
-            // We require new command buffers!
-            //TODO: Currently we only support this if previous graph was empty
-            ASSERT(!oldCommandBufferCountPerFrame);
-            vkResetCommandPool(result->context->device, result->commandPools[0], 0);
-            vkResetCommandPool(result->context->device, result->commandPools[1], 0);
-            for(u32 i = 0; i < result->commandBufferCountPerFrame * 2; ++i) {
+        result->commandBuffers = ARENA_PUSH_ARRAY(&result->arena, result->commandBufferCountPerFrame * RENDER_GRAPH_FRAMES_IN_FLIGHT, VkCommandBuffer);
+        growCommandBuffers(result->context, result->commandPools, result->commandBuffers, result->commandBufferCountPerFrame, oldCommandBuffers, oldCommandBufferCountPerFrame);
+
+        // Async passes record into command buffers from a pool of the compute queue family
+        if(usesAsyncQueue || oldAsyncCommandBuffers) {
+            if(!result->asyncCommandPools[0]) {
+                for(u32 i = 0; i < ARRAY_COUNT(result->asyncCommandPools); ++i) {
+                    VkCommandPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+                    createInfo.queueFamilyIndex = builder->context->computeQueues[0].familyIndex;
+                    vkCreateCommandPool(builder->context->device, &createInfo, 0, &result->asyncCommandPools[i]);
+                }
+            }
+            result->asyncCommandBuffers = ARENA_PUSH_ARRAY(&result->arena, result->commandBufferCountPerFrame * RENDER_GRAPH_FRAMES_IN_FLIGHT, VkCommandBuffer);
+            growCommandBuffers(result->context, result->asyncCommandPools, result->asyncCommandBuffers, result->commandBufferCountPerFrame, oldAsyncCommandBuffers, oldAsyncCommandBuffers ? oldCommandBufferCountPerFrame : 0);
+        }
+
+        // Static passes use one command buffer per frame slot from pools that are never reset. Command buffers of the old graph are reused
+        // by index. A frame slot only records its own command buffers after waiting for its fence, so none of them is still pending
+        u32 staticCommandBufferCounts[RENDER_GRAPH_QUEUE_COUNT] = {0};
+        for(u32 i = 0; i < result->passCount; ++i) {
+            RenderGraphPass* pass = &result->sortedPasses[i];
+            if(pass->staticPass) {
+                pass->staticCommandBufferIndex = staticCommandBufferCounts[pass->queue];
+                staticCommandBufferCounts[pass->queue] += RENDER_GRAPH_FRAMES_IN_FLIGHT;
+            }
+        }
+        for(u32 queue = 0; queue < RENDER_GRAPH_QUEUE_COUNT; ++queue) {
+            u32 oldCount = result->staticCommandBufferCounts[queue];
+            u32 count = MAX(staticCommandBufferCounts[queue], oldCount);
+            if(!count) {
+                continue;
+            }
+            if(!result->staticCommandPools[queue]) {
+                VkCommandPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+                createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+                createInfo.queueFamilyIndex = queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE ? builder->context->computeQueues[0].familyIndex : builder->context->graphicsQueues[0].familyIndex;
+                vkCreateCommandPool(builder->context->device, &createInfo, 0, &result->staticCommandPools[queue]);
+            }
+            result->staticCommandBuffers[queue] = ARENA_PUSH_ARRAY_NO_CLEAR(&result->arena, count, VkCommandBuffer);
+            if(oldCount) {
+                MEMORY_COPY(result->staticCommandBuffers[queue], oldStaticCommandBuffers[queue], sizeof(VkCommandBuffer) * oldCount);
+            }
+            if(count > oldCount) {
                 VkCommandBufferAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
                 allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-                allocateInfo.commandPool = result->commandPools[i>=result->commandBufferCountPerFrame];
-                allocateInfo.commandBufferCount = 1;
-                vkAllocateCommandBuffers(result->context->device, &allocateInfo, &result->commandBuffers[i]);
+                allocateInfo.commandPool = result->staticCommandPools[queue];
+                allocateInfo.commandBufferCount = count - oldCount;
+                vkAllocateCommandBuffers(result->context->device, &allocateInfo, result->staticCommandBuffers[queue] + oldCount);
+            }
+            result->staticCommandBufferCounts[queue] = count;
+        }
+
+        // Secondary command buffers come from the pools of the recording thread. Thread 0 only has pools if a pass needs them
+        for(u32 i = 0; i < result->passCount; ++i) {
+            if(result->sortedPasses[i].secondaryCommandBufferCount) {
+                renderGraphSetRecordingThreadCount(result, 1);
+                break;
             }
         }
-        for(u32 i = 0; i < result->commandBufferCountPerFrame; ++i) {
-            stromboliNameObject(result->context, (u64)result->commandBuffers[i], VK_OBJECT_TYPE_COMMAND_BUFFER, str8GetCstr(builder->arena, result->sortedPasses[i].name));
-            stromboliNameObject(result->context, (u64)result->commandBuffers[i+result->commandBufferCountPerFrame], VK_OBJECT_TYPE_COMMAND_BUFFER, str8GetCstr(builder->arena, result->sortedPasses[i].name));
+
+        for(u32 i = 0; i < result->passCount; ++i) {
+            const char* name = str8GetCstr(builder->arena, result->sortedPasses[i].name);
+            for(u32 slot = 0; slot < RENDER_GRAPH_FRAMES_IN_FLIGHT; ++slot) {
+                stromboliNameObject(result->context, (u64)result->commandBuffers[i+slot*result->commandBufferCountPerFrame], VK_OBJECT_TYPE_COMMAND_BUFFER, name);
+            }
         }
     }
 
@@ -515,3 +2874,171 @@ RenderGraph* renderGraphCompile(RenderGraphBuilder* builder, RenderGraphImageHan
     // Memory should be cleared as part of frameArena reset in application frame loop
     return result;
 }
+
+// Replaces the image of a barrier that refers to a recreated image. The first use of an image also gets the new alias accesses.
+// passIndex is the sorted pass recording the barrier if it may be a first use and UINT32_MAX otherwise
+// Images a resize recreated. Sorted by their old VkImage so every barrier finds its image with a binary search
+struct RenderGraphReplacedImages {
+    u32* order; // Indices of the replaced images sorted by oldImages
+    u64* oldImages; // Old VkImage of every image of the graph
+    u32 count;
+};
+
+static void patchResizedImageBarrier(RenderGraph* graph, VkImageMemoryBarrier2KHR* barrier, struct RenderGraphReplacedImages* replaced, u32 passIndex) {
+    u64 key = (u64)barrier->image;
+    u32 first = 0;
+    u32 last = replaced->count;
+    while(first < last) {
+        u32 middle = first + (last - first) / 2;
+        if(replaced->oldImages[replaced->order[middle]] < key) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    if(first == replaced->count || replaced->oldImages[replaced->order[first]] != key) {
+        return;
+    }
+    u32 imageIndex = replaced->order[first];
+    barrier->image = graph->images[imageIndex].image;
+    struct RenderGraphImageLifetime* lifetime = &graph->imageLifetimes[imageIndex];
+    if(passIndex != UINT32_MAX && passIndex == lifetime->firstAccessPass && barrier->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
+        barrier->srcStageMask = lifetime->aliasStage;
+        barrier->srcAccessMask = lifetime->aliasAccess;
+        restrictFirstAccessScope(graph->sortedPasses[passIndex].queue, barrier->dstStageMask, &barrier->srcStageMask, &barrier->srcAccessMask);
+    }
+}
+
+void renderGraphResize(RenderGraph* graph, u32 width, u32 height) {
+    if(!graph->passCount || !width || !height || (graph->outputWidth == width && graph->outputHeight == height)) {
+        return;
+    }
+    StromboliContext* context = graph->context;
+    MemoryArena* scratch = threadContextGetScratch(0);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+
+    // Pending executions keep using the old images. They are retired and destroyed once those executions are done
+    graph->outputWidth = width;
+    graph->outputHeight = height;
+    invalidateStaticPasses(graph); // Static command buffers reference the old images
+
+    u32 imageCount = graph->imageCount;
+    StromboliImage* oldImages = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, StromboliImage);
+    MEMORY_COPY(oldImages, graph->images, sizeof(StromboliImage) * imageCount);
+    bool* fixed = ARENA_PUSH_ARRAY(scratch, imageCount, bool);
+    struct RenderGraphImageLifetime* lifetimes = graph->imageLifetimes;
+    for(u32 i = 0; i < imageCount; ++i) {
+        struct RenderGraphImagePlacement* placement = &graph->imagePlacements[i];
+        StromboliImage* image = &graph->images[i];
+        fixed[i] = true;
+        if(placement->widthScale <= 0.0f) {
+            continue;
+        }
+        u32 newWidth = getScaledSize(width, placement->widthScale);
+        u32 newHeight = getScaledSize(height, placement->heightScale);
+        if(newWidth == image->width && newHeight == image->height) {
+            continue;
+        }
+        if(placement->memoryType == UINT32_MAX) {
+            // The acquired swapchain image is used directly so only the extent used for rendering changes
+            image->width = newWidth;
+            image->height = newHeight;
+            continue;
+        }
+        fixed[i] = false;
+        *image = renderGraphCreateFramebuffer(context, newWidth, newHeight, image->format, placement->usage, image->samples, image->mipCount, placement->layerCount, &lifetimes[i].memoryRequirements);
+        lifetimes[i].memoryType = findImageMemoryType(context, placement->usage, lifetimes[i].memoryRequirements.memoryTypeBits);
+    }
+
+    // Images that keep their size also keep their memory unless their heap has to grow
+    renderGraphPlaceAndBindImages(graph, context, scratch, lifetimes, fixed);
+
+    // Barriers keep their order and masks. Only the images and the alias accesses of first uses change
+    struct RenderGraphReplacedImages replaced = {0};
+    replaced.order = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u32);
+    replaced.oldImages = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageCount, u64);
+    for(u32 i = 0; i < imageCount; ++i) {
+        replaced.oldImages[i] = (u64)oldImages[i].image;
+        if(!fixed[i]) {
+            replaced.order[replaced.count++] = i;
+        }
+    }
+    sortImagesByKey(replaced.order, replaced.oldImages, replaced.count, scratch);
+    for(u32 passIndex = 0; passIndex < graph->passCount; ++passIndex) {
+        RenderGraphPass* pass = &graph->sortedPasses[passIndex];
+        for(u32 i = 0; i < pass->imageBarrierCount; ++i) {
+            patchResizedImageBarrier(graph, &pass->imageBarriers[i], &replaced, passIndex);
+        }
+        for(u32 i = 0; i < pass->afterClearBarrierCount; ++i) {
+            patchResizedImageBarrier(graph, &pass->afterClearBarriers[i], &replaced, UINT32_MAX);
+        }
+        for(u32 i = 0; i < pass->releaseImageBarrierCount; ++i) {
+            patchResizedImageBarrier(graph, &pass->releaseImageBarriers[i], &replaced, UINT32_MAX);
+        }
+    }
+    for(u32 i = 0; i < graph->eventDependencyCount; ++i) {
+        struct RenderGraphEventDependency* dependency = &graph->eventDependencies[i];
+        for(u32 j = 0; j < dependency->dependencyInfo.imageMemoryBarrierCount; ++j) {
+            patchResizedImageBarrier(graph, &dependency->imageBarriers[j], &replaced, UINT32_MAX);
+        }
+    }
+    patchResizedImageBarrier(graph, &graph->finalImageBarrier, &replaced, UINT32_MAX);
+
+    // Replaced images and their views go through the retire queue like the heaps replaced during placement
+    for(u32 i = 0; i < graph->subresourceCount; ++i) {
+        if(!fixed[getImageHandleData(graph->subresources[i].handle)]) {
+            retireResource(graph, RENDER_GRAPH_RETIRED_VIEW)->view = graph->subresources[i].image.view;
+        }
+    }
+    renderGraphCreateSubresourceViews(graph, context, fixed);
+    for(u32 i = 0; i < imageCount; ++i) {
+        if(!fixed[i]) {
+            retireResource(graph, RENDER_GRAPH_RETIRED_IMAGE)->image = oldImages[i];
+        }
+    }
+
+    // Readback buffers must fit the new extent. Their pending data is lost
+    for(u32 i = 0; i < graph->readbackCount; ++i) {
+        struct RenderGraphReadback* readback = &graph->readbacks[i];
+        if(fixed[readback->imageIndex]) {
+            continue;
+        }
+        for(u32 j = 0; j < RENDER_GRAPH_READBACK_RING_SIZE; ++j) {
+            retireResource(graph, RENDER_GRAPH_RETIRED_BUFFER)->buffer = readback->buffers[j];
+        }
+        createReadbackBuffers(context, readback, &graph->images[readback->imageIndex]);
+    }
+
+    arenaEndTemp(temp);
+}
+
+struct RenderGraphBarrierStatistics renderGraphGetBarrierStatistics(RenderGraph* graph) {
+    struct RenderGraphBarrierStatistics result = {0};
+    result.barrierCount = graph->barrierCount;
+    result.splitBarrierCount = graph->splitBarrierCount;
+    result.removedBarrierCount = graph->removedBarrierCount;
+    return result;
+}
+
+struct RenderGraphSubmitStatistics renderGraphGetSubmitStatistics(RenderGraph* graph) {
+    struct RenderGraphSubmitStatistics result = {0};
+    result.passCount = graph->passCount;
+    result.commandBufferCount = graph->commandBufferCount;
+    result.submitCount = graph->batchCount;
+    return result;
+}
+
+struct RenderGraphMemoryStatistics renderGraphGetMemoryStatistics(RenderGraph* graph) {
+    struct RenderGraphMemoryStatistics result = {0};
+    result.imageCount = graph->imageCount;
+    result.aliasedImageCount = graph->aliasedImageCount;
+    result.reusedImageCount = graph->reusedImageCount;
+    result.transientImageCount = graph->transientImageCount;
+    result.peakMemory = graph->imagePeakMemorySize;
+    result.lazilyAllocatedMemory = graph->imageLazyMemorySize;
+    result.unaliasedMemory = graph->imageMemorySize;
+    if(graph->imageMemorySize > graph->imagePeakMemorySize) {
+        result.aliasedMemory = graph->imageMemorySize - graph->imagePeakMemorySize;
+    }
+    return result;
+}
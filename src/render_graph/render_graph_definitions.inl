@@ -8,15 +8,49 @@
 #endif
 STATIC_ASSERT(FINGERPRINT_BITS > 0);
 
+STATIC_ASSERT(RENDER_GRAPH_FRAMES_IN_FLIGHT > 0);
+STATIC_ASSERT(RENDER_GRAPH_READBACK_RING_SIZE >= RENDER_GRAPH_FRAMES_IN_FLIGHT); // Every execution in flight needs its own readback buffer
+
+#ifndef RENDER_GRAPH_MAX_RECORDING_THREADS
+#define RENDER_GRAPH_MAX_RECORDING_THREADS 16
+#endif
+
 #ifndef TIMING_SECTION_COUNT
 #define TIMING_SECTION_COUNT 256
 #endif
+// Queries 0 and 1 measure the whole graph. Every other pair belongs to one pass
+#define MAX_TIMED_PASS_COUNT (TIMING_SECTION_COUNT - 1)
+
+// Barriers whose source pass is at least this many sorted passes before the consuming pass are split into an event set and wait.
+// Passes in between can then overlap with the dependency. 0 disables split barriers
+#ifndef RENDER_GRAPH_SPLIT_BARRIER_DISTANCE
+#define RENDER_GRAPH_SPLIT_BARRIER_DISTANCE 2
+#endif
+
+#ifndef RENDER_GRAPH_DEFAULT_TIMING_WINDOW
+#define RENDER_GRAPH_DEFAULT_TIMING_WINDOW 64
+#endif
+
+// Bounds of the render scale chosen by the frame time controller and the fraction of the correction applied per execution
+#ifndef RENDER_GRAPH_MIN_RENDER_SCALE
+#define RENDER_GRAPH_MIN_RENDER_SCALE 0.5f
+#endif
+#ifndef RENDER_GRAPH_RENDER_SCALE_SMOOTHING
+#define RENDER_GRAPH_RENDER_SCALE_SMOOTHING 0.25f
+#endif
 
 // Leaves all bits where the fingerprint is not present
 #define INVERSE_FINGERPRINT_MASK (0xFFFFFFFF >> FINGERPRINT_BITS)
 STATIC_ASSERT(IS_MASK(INVERSE_FINGERPRINT_MASK));
 #define FINGERPRINT_SHIFT (32 - FINGERPRINT_BITS)
 
+// Subresource of an image handle: the selected mip level + 1 in the lower bits and the selected array layer + 1 above. 0 selects all mips or layers
+#define IMAGE_MIP_BITS 16
+#define IMAGE_LAYER_SHIFT IMAGE_MIP_BITS
+#define IMAGE_LAYER_BITS (32 - IMAGE_LAYER_SHIFT)
+#define RENDER_GRAPH_MAX_MIP_COUNT ((1u << IMAGE_MIP_BITS) - 1)
+#define RENDER_GRAPH_MAX_LAYER_COUNT ((1u << IMAGE_LAYER_BITS) - 1)
+
 enum RenderGraphPassType {
     RENDER_GRAPH_PASS_TYPE_GRAPHICS = 0,
     RENDER_GRAPH_PASS_TYPE_COMPUTE,
@@ -25,14 +59,42 @@ enum RenderGraphPassType {
     RENDER_GRAPH_PASS_TYPE_COUNT,
 };
 
+enum RenderGraphQueue {
+    RENDER_GRAPH_QUEUE_GRAPHICS = 0,
+    RENDER_GRAPH_QUEUE_ASYNC_COMPUTE,
+    RENDER_GRAPH_QUEUE_COUNT,
+};
+
+enum RenderGraphRetiredType {
+    RENDER_GRAPH_RETIRED_IMAGE = 0,
+    RENDER_GRAPH_RETIRED_BUFFER,
+    RENDER_GRAPH_RETIRED_VIEW,
+    RENDER_GRAPH_RETIRED_MEMORY,
+};
+
+// Resource of an old compilation or replaced by a resize. Destroyed once every execution submitted before it was retired has finished
+struct RenderGraphRetiredResource {
+    u64 executionCount; // executionCount when the resource was retired
+    enum RenderGraphRetiredType type;
+    union {
+        StromboliImage image;
+        StromboliBuffer buffer;
+        VkImageView view;
+        VkDeviceMemory memory; // Replaced image heap
+    };
+};
+
 typedef struct RenderGraphBuildImage {
-    struct RenderGraphBuildImage* next;
     StromboliImage image;
-    struct RenderGraphBuildPass* producer;
+    RenderGraphPassHandle producer; // A handle value of 0 means that this image has no producer
     VkImageUsageFlags usage;
     VkFormat format;
     VkClearValue clearColor;
+    float widthScale; // Size relative to the output size of the builder. 0 if the image has a fixed size
+    float heightScale;
+    u32 layerCount; // The mip count is stored in image
     bool isSwpachainOutput;
+    bool importedSwapchain; // Not backed by graph memory. The acquired swapchain image is used when the producing pass begins
     bool requiresClear; // Only used for renderGraphCreateClearedFramebuffer as we cannot use attachment clear directly there
 } RenderGraphImage;
 
@@ -41,25 +103,125 @@ struct RenderAttachment {
     VkAccessFlags access;
     VkPipelineStageFlags2 stage;
     VkImageUsageFlags usage;
-    RenderGraphImageHandle imageHandle;
-    struct RenderGraphBuildPass* producer; // We store producer here for combined input+output framebuffer support (as producers are changing for a single image)
-    struct RenderGraphBuildPass* lastReader; // Can be null
+    RenderGraphImageHandle imageHandle; // Might select a single mip level or array layer. Barriers of the attachment only cover the selected subresources
+    RenderGraphPassHandle producer; // We store producer here for combined input+output framebuffer support (as producers are changing for a single image)
+    RenderGraphPassHandle lastReader; // Can be 0
     bool requiresClear;
     bool resolveTarget; // This attachment is used as a resolve target and otherwise unused in the pass
     RenderGraphImageHandle resolve; // The optional handle to an output where this attachment should be resolved to
     VkResolveModeFlags resolveMode;
+    VkAttachmentLoadOp loadOp; // Derived from the sorted pass order when compiling. Only used for graphics pass outputs
+    VkAttachmentStoreOp storeOp;
+    u32 subresourceIndex; // Index into the subresources of the compiled graph. UINT32_MAX if the attachment uses the whole image
+};
+
+typedef struct RenderGraphBuildBuffer {
+    u64 size;
+    RenderGraphPassHandle producer; // A handle value of 0 means that this buffer has no producer
+    VkBufferUsageFlags usage;
+    u32 clearValue;
+    bool requiresClear; // Only used for renderGraphCreateClearedBuffer. The first writer fills the buffer with clearValue
+} RenderGraphBuffer;
+
+struct RenderBufferAttachment {
+    VkAccessFlags2 access;
+    VkPipelineStageFlags2 stage;
+    VkBufferUsageFlags usage;
+    RenderGraphBufferHandle bufferHandle;
+    RenderGraphPassHandle producer; // Producer at the time this attachment was added
+    bool requiresClear;
 };
 
 struct RenderGraphBuildPass {
     String8 name;
-    struct RenderGraphBuildPass* next;
     enum RenderGraphPassType type;
 
     struct RenderAttachment inputs[8];
     struct RenderAttachment outputs[8];
     u32 inputCount;
     u32 outputCount;
+    struct RenderBufferAttachment bufferInputs[8];
+    struct RenderBufferAttachment bufferOutputs[8];
+    u32 bufferInputCount;
+    u32 bufferOutputCount;
     bool external; // This indicates that this pass produces external output and must not be evicted when compiling
+    bool async; // Compute pass that may be scheduled on a dedicated compute queue
+    bool staticPass; // Set by renderPassSetStatic
+    u32 secondaryCommandBufferCount; // Set by renderPassSetSecondaryCommandBufferCount
+    u32 viewMask; // Set by renderPassSetViewMask
+    bool readback; // Transfer pass added by renderGraphAddReadbackPass. Input 0 is read back. Output 0 is the format conversion target if present
+};
+
+// Pass flags hashBuilder covers. Kept for every build pass as compiling overrides them for the swapchain output pass
+struct RenderGraphBuildPassFlags {
+    bool external;
+    bool async;
+    bool staticPass;
+    bool readback;
+};
+
+// Consecutive passes in sorted order that are submitted together to the same queue
+struct RenderGraphSubmitBatch {
+    enum RenderGraphQueue queue;
+    u32 firstPass;
+    u32 passCount;
+    u32 waitBatch; // Batch on the other queue that has to finish before this batch can start. UINT32_MAX if there is none
+    VkPipelineStageFlags2 waitStage;
+    VkSemaphore signalSemaphores[RENDER_GRAPH_FRAMES_IN_FLIGHT]; // One per frame slot. Only set if another batch waits on this batch
+};
+
+// Barriers of one pass that only wait for a single earlier pass on the same queue. The earlier pass sets the event at its end and the pass waits for it when it begins
+struct RenderGraphEventDependency {
+    u32 setPass;
+    u32 waitPass;
+    VkDependencyInfoKHR dependencyInfo; // Set and wait must use identical dependency infos
+    VkImageMemoryBarrier2KHR* imageBarriers;
+    VkBufferMemoryBarrier2KHR* bufferBarriers;
+};
+
+// Host copies of an image. Entry i holds the data of the last execution whose index modulo RENDER_GRAPH_READBACK_RING_SIZE is i
+struct RenderGraphReadback {
+    u32 buildPassIndex;
+    u32 imageIndex; // Image copied into the buffers
+    u32 blitSourceIndex; // Image blitted into imageIndex first to convert the format. UINT32_MAX if no conversion is required
+    u32 texelSize;
+    StromboliBuffer buffers[RENDER_GRAPH_READBACK_RING_SIZE];
+    u64 executionIndices[RENDER_GRAPH_READBACK_RING_SIZE]; // UINT64_MAX if the entry was never recorded
+    VkExtent2D extents[RENDER_GRAPH_READBACK_RING_SIZE];
+};
+
+// Command buffers allocated on demand by the owning thread and reused every frame
+struct RenderGraphCommandBufferList {
+    VkCommandBuffer* commandBuffers;
+    u32 capacity;
+    u32 count;
+    u32 usedCount; // Reset when the frame slot is recorded again
+};
+
+// Command pools of one recording thread. Everything except creation and the per frame reset is only touched by the owning thread.
+// Thread 0 records passes into the command buffers owned by the graph and only uses its pools for secondary command buffers
+struct RenderGraphThreadPool {
+    MemoryArena arena; // Backing memory for growing the command buffer lists
+    VkCommandPool commandPools[RENDER_GRAPH_FRAMES_IN_FLIGHT][RENDER_GRAPH_QUEUE_COUNT]; // Per frame slot and queue
+    struct RenderGraphCommandBufferList primaryCommandBuffers[RENDER_GRAPH_FRAMES_IN_FLIGHT][RENDER_GRAPH_QUEUE_COUNT];
+    struct RenderGraphCommandBufferList secondaryCommandBuffers[RENDER_GRAPH_FRAMES_IN_FLIGHT]; // Only used inside graphics passes
+};
+
+// Where a graph image lives inside the image heap of its memory type. Used to reuse images across recompiles
+struct RenderGraphImagePlacement {
+    VkImageUsageFlags usage;
+    u32 memoryType; // UINT32_MAX if the image is not backed by graph memory
+    u64 offset;
+    VkMemoryRequirements memoryRequirements;
+    float widthScale; // Copied from the build image. Images with a scale are recreated by renderGraphResize
+    float heightScale;
+    u32 layerCount;
+};
+
+// View of a single mip level or array layer of a graph image. image is a copy of the graph image with view and size of the subresource
+struct RenderGraphSubresource {
+    RenderGraphImageHandle handle; // Without fingerprint
+    StromboliImage image;
 };
 
 struct RenderGraphMemoryBlock {
@@ -73,20 +235,60 @@ struct RenderGraphMemoryBlock {
 struct RenderGraphPass {
     String8 name;
     RenderGraph* graph;
-    VkCommandBuffer commandBuffer;
+    VkCommandBuffer commandBuffer; // 0 until the pass is begun in the current execution
     enum RenderGraphPassType type;
+    enum RenderGraphQueue queue;
+    u32 commandBufferIndex; // Index into the command buffers of a frame slot
+    bool batched; // Records into the command buffer of the previous sorted pass. Set by pass batching
+    bool staticPass; // Recorded once per frame slot and replayed until the graph is recompiled or the pass is invalidated
+    bool replayed; // The static command buffer of the current frame slot is submitted without recording
+    u32 staticCommandBufferIndex; // Frame slot i uses staticCommandBuffers[queue][staticCommandBufferIndex+i]
+    float staticRenderScales[RENDER_GRAPH_FRAMES_IN_FLIGHT]; // Render scale the static command buffer of each frame slot was recorded with. 0 if it has to be recorded
+
+    // Secondary command buffers of a graphics pass. They are executed in index order when the pass ends
+    u32 secondaryCommandBufferCount;
+    VkCommandBuffer* secondaryCommandBuffers; // 0 for indices that were not handed out in the current execution
+    // Inheritance of the secondary command buffers. Filled when the pass is begun
+    VkFormat colorAttachmentFormats[8];
+    u32 colorAttachmentCount;
+    VkFormat depthAttachmentFormat;
+    VkSampleCountFlagBits rasterizationSamples;
+    VkExtent2D renderExtent;
+    u32 viewMask; // Multiview rendering. Bit i broadcasts the draws to layer i of the outputs
     //u32 passIndex;
 
     struct RenderAttachment inputs[8];
     struct RenderAttachment outputs[8];
     u32 inputCount;
     u32 outputCount;
+    struct RenderBufferAttachment bufferInputs[8];
+    struct RenderBufferAttachment bufferOutputs[8];
+    u32 bufferInputCount;
+    u32 bufferOutputCount;
 
     u32 imageBarrierCount;
     VkImageMemoryBarrier2KHR* imageBarriers;
+    u32 bufferBarrierCount;
+    VkBufferMemoryBarrier2KHR* bufferBarriers;
 
     u32 afterClearBarrierCount;
     VkImageMemoryBarrier2KHR* afterClearBarriers;
+    u32 afterClearBufferBarrierCount;
+    VkBufferMemoryBarrier2KHR* afterClearBufferBarriers;
+
+    // Queue family ownership releases recorded at the end of the pass for resources used next on the other queue
+    u32 releaseImageBarrierCount;
+    VkImageMemoryBarrier2KHR* releaseImageBarriers;
+    u32 releaseBufferBarrierCount;
+    VkBufferMemoryBarrier2KHR* releaseBufferBarriers;
+
+    // Split barriers. Indices into graph->eventDependencies
+    u32 firstEventWait; // Waits of a pass are stored consecutively
+    u32 eventWaitCount;
+    u32* eventSets;
+    u32 eventSetCount;
+
+    struct RenderGraphReadback* readback; // Only set for readback passes
 
 #ifdef TRACY_ENABLE
     TracyStromboliScope tracyScope;
@@ -98,45 +300,148 @@ struct RenderGraph {
     ArenaMarker resetMarker;
 
     StromboliContext* context;
-    VkSemaphore imageAcquireSemaphore;
+    VkSemaphore imageAcquireSemaphores[RENDER_GRAPH_FRAMES_IN_FLIGHT];
+    VkFence frameFences[RENDER_GRAPH_FRAMES_IN_FLIGHT]; // Signaled once the last execution recorded in the frame slot has finished
+    u32 frameSlot; // Frame slot that is currently recorded. Survives recompilation
+    u64 executionCount; // Number of submitted executions. Survives recompilation
     VkSemaphore imageReleaseSemaphores[MAX_SWAPCHAIN_IMAGES];
+    VkSemaphore frameSemaphores[RENDER_GRAPH_FRAMES_IN_FLIGHT][RENDER_GRAPH_QUEUE_COUNT]; // Signaled on a queue at the start of an execution. Waited for by the first batch on the other queue
+    bool asyncQueueUsed; // The last submitted execution used the async compute queue. Survives recompilation
+    VkSemaphore timelineSemaphore; // Created by the first offscreen execution. Survives recompilation
+    u64 timelineValue; // Signaled once the last offscreen execution has finished
+
+    // Background compilation
+    GroundedMutex pendingGraphMutex; // Guards pendingGraph
+    RenderGraph* pendingGraph; // Compiled on another thread. Replaces this graph in renderGraphSwapPending
+    RenderGraph* retiredGraph; // The graph this graph replaced. Destroyed once the first execution of this graph has finished
+    u64 retiredExecutionCount; // executionCount when retiredGraph was replaced
     RenderGraphImageHandle finalImageHandle;
-    VkImageMemoryBarrier2KHR finalImageBarrier;
+    VkImageMemoryBarrier2KHR finalImageBarrier; // Transition to the blit source. When rendering directly into the swapchain the transition from the acquired image instead
+    VkImageMemoryBarrier2KHR presentBarrier; // Only used when rendering directly into the swapchain. The image is set after acquiring
+    StromboliSwapchain* swapchain; // Only set if the swapchain output pass renders directly into the swapchain image
+    u32 swapchainImageIndex;
+    bool swapchainImageAcquired;
     u32 swapchainOutputPassIndex; // required to know where to put layout transitions for swapchain images
 
     RenderGraphPass* sortedPasses;
     u32 passCount;
     u32 commandBufferCountPerFrame;
-    u16* buildPassToSortedPass;
+    u16* buildPassToSortedPass; // Indexed by pass handle data - 1. UINT16_MAX if the pass has been culled
+    u32 buildPassCount;
 
     StromboliImage* images;
+    struct RenderGraphImagePlacement* imagePlacements;
+    struct RenderGraphImageLifetime* imageLifetimes; // Kept so renderGraphResize can place resized images without recompiling
     VkClearValue* clearValues;
     u32 imageCount;
+    struct RenderGraphSubresource* subresources; // Every subresource selected by an attachment. Sorted by getSubresourceKey
+    u32 subresourceCount;
+    u32 outputWidth; // Size the relative images are currently created for
+    u32 outputHeight;
     u32 fingerprint;
+    u64 builderHash; // Structural hash of the builder this graph was compiled from. Used to skip recompilation
+    // Builder state covered by builderHash that the compiled graph does not keep otherwise. Copied before compiling changes the builder
+    struct RenderGraphBuildPassFlags* buildPassFlags; // Indexed by pass handle data - 1
+    struct RenderGraphBuildImage* buildImages;
+    struct RenderGraphBuildBuffer* buildBuffers;
+    enum RenderGraphScheduleMode scheduleMode;
+    bool batchPasses;
+    bool directSwapchain; // canRenderDirectlyToSwapchain of the builder
+
+    StromboliBuffer* buffers;
+    u32* bufferClearValues;
+    u32 bufferCount;
 
-    StromboliImage* imageDeleteQueue; // Images to delete once we have waited for the respective fence
-    u32 imageDeleteCount;
+    struct RenderGraphRetiredResource* retiredResources; // Ordered by executionCount. Survives recompilation
+    u32 retiredResourceCount;
+    u32 retiredResourceCapacity;
+    VkPipelineStageFlags2 imageHeapStages[VK_MAX_MEMORY_TYPES]; // Last accesses of all images in each heap during one execution. The first execution of a recompiled graph waits for them
+    VkAccessFlags2 imageHeapAccesses[VK_MAX_MEMORY_TYPES];
+    u64 imageMemorySize; // Memory all used images would require without aliasing
+    u64 imagePeakMemorySize; // Memory actually bound to images after aliasing
+    u64 imageLazyMemorySize; // Part of imagePeakMemorySize in lazily allocated memory
+    u32 transientImageCount; // Number of images that only live inside a single graphics pass
+    u32 aliasedImageCount; // Number of images sharing memory with at least one other image
+    u32 reusedImageCount; // Number of images reused from the previous compilation
+    u32 barrierCount; // Barriers recorded per execution
+    u32 removedBarrierCount; // Barriers that were covered by other barriers and therefore removed while compiling
+    u32 splitBarrierCount; // Barriers recorded as part of an event dependency instead of a pipeline barrier
     float lastDuration; // The total duration of the last execution in seconds
-    u32 timestampCount;
+    u32 timedPassCount; // Sorted pass i writes the queries 2+2*i and 3+2*i
+    u32 pendingTimestampCounts[RENDER_GRAPH_FRAMES_IN_FLIGHT]; // Queries written by the last execution of each frame slot
+    u32 pendingTimedPassCounts[RENDER_GRAPH_FRAMES_IN_FLIGHT]; // 0 if the pass timestamps of the frame slot do not match the current passes
+    u32 timingWindow; // Number of executions used for the pass timing statistics. Survives recompilation
+    u32 timingSampleCount;
+    u32 nextTimingSample;
+    float* passTimingSamples; // timingWindow samples per timed pass in seconds. Sample j of pass i is at i*timingWindow+j
+    float renderScale; // Relative images are only rendered in the top left renderScale part. Survives recompilation
+    float targetFrameTime; // Duration in seconds the render scale controller aims for. 0 if the controller is disabled
+
+    VkQueryPool queryPools[RENDER_GRAPH_FRAMES_IN_FLIGHT];
+    VkCommandPool commandPools[RENDER_GRAPH_FRAMES_IN_FLIGHT];
+    VkCommandBuffer* commandBuffers; // Pass i uses i+frameSlot*commandBufferCountPerFrame
+
+    // Async compute. Only created when the graph contains passes scheduled on the compute queue
+    VkCommandPool asyncCommandPools[RENDER_GRAPH_FRAMES_IN_FLIGHT];
+    VkCommandBuffer* asyncCommandBuffers; // Indexed like commandBuffers
+
+    // Static passes. Their pools are never reset as a whole so the recorded command buffers can be submitted again
+    VkCommandPool staticCommandPools[RENDER_GRAPH_QUEUE_COUNT];
+    VkCommandBuffer* staticCommandBuffers[RENDER_GRAPH_QUEUE_COUNT]; // Only grows
+    u32 staticCommandBufferCounts[RENDER_GRAPH_QUEUE_COUNT];
+    struct RenderGraphSubmitBatch* batches;
+    u32 batchCount;
+    u32 joinBatch; // Async batch the final submission has to wait for as no graphics batch follows it. UINT32_MAX if not required
+    u32 commandBufferCount; // Command buffers recorded per execution. Equals passCount without pass batching
+    VkSemaphore* queueSemaphores; // Binary semaphores for cross queue dependencies. Only grows
+    u32 queueSemaphoreCount;
+
+    struct RenderGraphReadback* readbacks;
+    u32 readbackCount;
 
-    VkQueryPool queryPools[2];
-    VkCommandPool commandPools[2];
-    VkCommandBuffer* commandBuffers; // Each pass uses passIndex+commandBufferOffset as its pass
-    u32 commandBufferOffset; // Switches between 0 and commandBufferCountPerFrame
+    struct RenderGraphEventDependency* eventDependencies;
+    u32 eventDependencyCount;
+    VkEvent* events; // Dependency i uses events[i*RENDER_GRAPH_FRAMES_IN_FLIGHT+frameSlot]. Only grows
+    u32 eventCount;
 
-    struct RenderGraphMemoryBlock* firstBlock;
+    // Thread 0 records into commandBuffers/asyncCommandBuffers. All other threads use their own pools
+    struct RenderGraphThreadPool threadPools[RENDER_GRAPH_MAX_RECORDING_THREADS];
+    u32 recordingThreadCount;
+
+    struct RenderGraphMemoryBlock* firstBlock; // Buffer memory
+    VkPipelineStageFlags2 bufferMemoryStages; // Last accesses of all buffers during one execution. Buffers of a recompiled graph reuse the memory blocks and wait for them
+    VkAccessFlags2 bufferMemoryAccesses;
+    // One heap per memory type holding all images. Survives recompilation as long as the images still fit, so reused images keep their binding
+    VkDeviceMemory imageHeaps[VK_MAX_MEMORY_TYPES];
+    u64 imageHeapSizes[VK_MAX_MEMORY_TYPES];
 };
 
+// Passes and images are stored in flat arrays so a handle can be resolved with a single index operation.
+// The arrays grow by doubling inside the builder arena. Never keep pointers into them across calls that add passes or images!
 struct RenderGraphBuilder {
     MemoryArena* arena;
-    struct RenderGraphBuildPass passSentinel;
-    struct RenderGraphBuildImage imageSentinel;
+    struct RenderGraphBuildPass* passes; // Indexed by pass handle data - 1
+    struct RenderGraphBuildImage* images; // Indexed by image handle data
+    struct RenderGraphBuildBuffer* buffers; // Indexed by buffer handle data
+    u32 passCapacity;
+    u32 imageCapacity;
+    u32 bufferCapacity;
     StromboliContext* context;
     u32 currentResourceIndex;
+    u32 currentBufferIndex;
     u32 currentPassIndex;
     u32 fingerprint;
+    StromboliSwapchain* swapchain; // Set by renderGraphImportSwapchain
+    enum RenderGraphScheduleMode scheduleMode;
+    bool batchPasses; // Set by renderGraphSetPassBatching
+    u32 outputWidth; // Reference size for images with a relative size. Set by renderGraphSetOutputSize or renderGraphImportSwapchain
+    u32 outputHeight;
 };
 
+static inline u32 getScaledSize(u32 outputSize, float scale) {
+    return MAX((u32)(outputSize * scale), 1);
+}
+
 static inline u32 getPassFingerprint(RenderGraphPassHandle passHandle) {
     u32 result = ((passHandle.handle & (~INVERSE_FINGERPRINT_MASK)) >> FINGERPRINT_SHIFT);
     return result;
@@ -147,16 +452,84 @@ static inline u32 getImageFingerprint(RenderGraphImageHandle imageHandle) {
     return result;
 }
 
+static inline u32 getBufferFingerprint(RenderGraphBufferHandle bufferHandle) {
+    u32 result = ((bufferHandle.handle & (~INVERSE_FINGERPRINT_MASK)) >> FINGERPRINT_SHIFT);
+    return result;
+}
+
 static inline u32 getPassHandleData(RenderGraphPassHandle passHandle) {
     u32 result = passHandle.handle & INVERSE_FINGERPRINT_MASK;
     return result;
 }
 
+// Index of the image. Use getImageSubresourceData for the selected subresource
 static inline u32 getImageHandleData(RenderGraphImageHandle imageHandle) {
     u32 result = imageHandle.handle & INVERSE_FINGERPRINT_MASK;
     return result;
 }
 
+// 0 if the handle selects the whole image
+static inline u32 getImageSubresourceData(RenderGraphImageHandle imageHandle) {
+    u32 result = imageHandle.subresource;
+    return result;
+}
+
+// UINT32_MAX if all mip levels are selected
+static inline u32 getImageHandleMip(RenderGraphImageHandle imageHandle) {
+    u32 result = (imageHandle.subresource & ((1u << IMAGE_MIP_BITS) - 1)) - 1;
+    return result;
+}
+
+// UINT32_MAX if all array layers are selected
+static inline u32 getImageHandleLayer(RenderGraphImageHandle imageHandle) {
+    u32 result = (imageHandle.subresource >> IMAGE_LAYER_SHIFT) - 1;
+    return result;
+}
+
+// Orders subresources by image and then by the selected mip level and array layer
+static inline u64 getSubresourceKey(RenderGraphImageHandle imageHandle) {
+    u64 result = ((u64)getImageHandleData(imageHandle) << 32) | imageHandle.subresource;
+    return result;
+}
+
+// Whether two handles of the same image select at least one common subresource
+static inline bool imageHandlesOverlap(RenderGraphImageHandle a, RenderGraphImageHandle b) {
+    if(getImageHandleData(a) != getImageHandleData(b)) {
+        return false;
+    }
+    u32 mipA = getImageHandleMip(a);
+    u32 mipB = getImageHandleMip(b);
+    u32 layerA = getImageHandleLayer(a);
+    u32 layerB = getImageHandleLayer(b);
+    bool mipsOverlap = mipA == UINT32_MAX || mipB == UINT32_MAX || mipA == mipB;
+    bool layersOverlap = layerA == UINT32_MAX || layerB == UINT32_MAX || layerA == layerB;
+    return mipsOverlap && layersOverlap;
+}
+
+// Subresources selected by the handle. mipCount and layerCount are the counts of the whole image
+static inline VkImageSubresourceRange getImageHandleRange(RenderGraphImageHandle imageHandle, VkFormat format, u32 mipCount, u32 layerCount) {
+    VkImageSubresourceRange result = {0};
+    result.aspectMask = isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    result.levelCount = mipCount;
+    result.layerCount = layerCount;
+    u32 mip = getImageHandleMip(imageHandle);
+    u32 layer = getImageHandleLayer(imageHandle);
+    if(mip != UINT32_MAX) {
+        result.baseMipLevel = mip;
+        result.levelCount = 1;
+    }
+    if(layer != UINT32_MAX) {
+        result.baseArrayLayer = layer;
+        result.layerCount = 1;
+    }
+    return result;
+}
+
+static inline u32 getBufferHandleData(RenderGraphBufferHandle bufferHandle) {
+    u32 result = bufferHandle.handle & INVERSE_FINGERPRINT_MASK;
+    return result;
+}
+
 static inline bool isPassFingerprintValid(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle) {
     bool result = builder->fingerprint == getPassFingerprint(passHandle);
     return result;
@@ -167,14 +540,43 @@ static inline bool isImageFingerprintValid(RenderGraphBuilder* builder, RenderGr
     return result;
 }
 
+static inline bool isBufferFingerprintValid(RenderGraphBuilder* builder, RenderGraphBufferHandle bufferHandle) {
+    bool result = builder->fingerprint == getBufferFingerprint(bufferHandle);
+    return result;
+}
+
 static inline struct RenderGraphBuildImage* getImageFromHandle(RenderGraphBuilder* builder, RenderGraphImageHandle imageHandle) {
     ASSERT(isImageFingerprintValid(builder, imageHandle));
-    u32 stepCount = builder->currentResourceIndex - getImageHandleData(imageHandle) - 1;
-    struct RenderGraphBuildImage* image = builder->imageSentinel.next;
-    for(u32 i = 0; i < stepCount; ++i) {
-        image = image->next;
-    }
-    return image;
+    u32 imageIndex = getImageHandleData(imageHandle);
+    ASSERT(imageIndex < builder->currentResourceIndex);
+    return &builder->images[imageIndex];
+}
+
+static inline struct RenderGraphBuildBuffer* getBufferFromHandle(RenderGraphBuilder* builder, RenderGraphBufferHandle bufferHandle) {
+    ASSERT(isBufferFingerprintValid(builder, bufferHandle));
+    u32 bufferIndex = getBufferHandleData(bufferHandle);
+    ASSERT(bufferIndex < builder->currentBufferIndex);
+    return &builder->buffers[bufferIndex];
+}
+
+static inline struct RenderGraphBuildPass* getPassFromHandle(RenderGraphBuilder* builder, RenderGraphPassHandle passHandle) {
+    ASSERT(isPassFingerprintValid(builder, passHandle));
+    u32 passHandleValue = getPassHandleData(passHandle);
+    ASSERT(passHandleValue > 0 && passHandleValue < builder->currentPassIndex);
+    return &builder->passes[passHandleValue - 1];
+}
+
+// Index of the pass in the builder pass array. Pass handles start at 1 as 0 is used as the invalid handle
+static inline u32 getPassIndex(RenderGraphPassHandle passHandle) {
+    u32 result = getPassHandleData(passHandle) - 1;
+    return result;
+}
+
+// Subresources a compiled graph accesses through the handle
+static inline VkImageSubresourceRange getAttachmentRange(RenderGraph* graph, RenderGraphImageHandle imageHandle) {
+    u32 imageIndex = getImageHandleData(imageHandle);
+    StromboliImage* image = &graph->images[imageIndex];
+    return getImageHandleRange(imageHandle, image->format, image->mipCount, graph->imagePlacements[imageIndex].layerCount);
 }
 
 #endif // RENDER_GRAPH_DEFINITIONS
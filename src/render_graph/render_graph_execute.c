@@ -4,7 +4,282 @@
 
 #include <grounded/threading/grounded_threading.h>
 
+void renderGraphSetRecordingThreadCount(RenderGraph* graph, u32 threadCount) {
+    ASSERT(threadCount <= RENDER_GRAPH_MAX_RECORDING_THREADS);
+    threadCount = MIN(threadCount, RENDER_GRAPH_MAX_RECORDING_THREADS);
+    StromboliContext* context = graph->context;
+    u32 familyIndices[RENDER_GRAPH_QUEUE_COUNT];
+    familyIndices[RENDER_GRAPH_QUEUE_GRAPHICS] = context->graphicsQueues[0].familyIndex;
+    familyIndices[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE] = context->computeQueueCount ? context->computeQueues[0].familyIndex : context->graphicsQueues[0].familyIndex;
+
+    // Pools are never destroyed before the graph so growing again is cheap
+    for(u32 i = graph->recordingThreadCount; i < threadCount; ++i) {
+        struct RenderGraphThreadPool* threadPool = &graph->threadPools[i];
+        if(threadPool->commandPools[0][0]) {
+            continue;
+        }
+        threadPool->arena = createGrowingArena(osGetMemorySubsystem(), KB(4));
+        for(u32 slot = 0; slot < RENDER_GRAPH_FRAMES_IN_FLIGHT; ++slot) {
+            for(u32 queue = 0; queue < RENDER_GRAPH_QUEUE_COUNT; ++queue) {
+                VkCommandPoolCreateInfo createInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+                createInfo.queueFamilyIndex = familyIndices[queue];
+                vkCreateCommandPool(context->device, &createInfo, 0, &threadPool->commandPools[slot][queue]);
+            }
+        }
+    }
+    graph->recordingThreadCount = MAX(graph->recordingThreadCount, threadCount);
+}
+
+// Only called from the thread owning threadPool
+static VkCommandBuffer getThreadCommandBuffer(RenderGraph* graph, struct RenderGraphThreadPool* threadPool, u32 slot, enum RenderGraphQueue queue, VkCommandBufferLevel level) {
+    struct RenderGraphCommandBufferList* list = &threadPool->primaryCommandBuffers[slot][queue];
+    if(level == VK_COMMAND_BUFFER_LEVEL_SECONDARY) {
+        ASSERT(queue == RENDER_GRAPH_QUEUE_GRAPHICS);
+        list = &threadPool->secondaryCommandBuffers[slot];
+    }
+    if(list->usedCount == list->count) {
+        // Need another command buffer
+        if(list->count == list->capacity) {
+            u32 newCapacity = MAX(list->capacity * 2, 8);
+            VkCommandBuffer* newCommandBuffers = ARENA_PUSH_ARRAY_NO_CLEAR(&threadPool->arena, newCapacity, VkCommandBuffer);
+            MEMORY_COPY(newCommandBuffers, list->commandBuffers, sizeof(VkCommandBuffer) * list->count);
+            list->commandBuffers = newCommandBuffers;
+            list->capacity = newCapacity;
+        }
+        VkCommandBufferAllocateInfo allocateInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+        allocateInfo.level = level;
+        allocateInfo.commandPool = threadPool->commandPools[slot][queue];
+        allocateInfo.commandBufferCount = 1;
+        vkAllocateCommandBuffers(graph->context->device, &allocateInfo, &list->commandBuffers[list->count++]);
+    }
+    return list->commandBuffers[list->usedCount++];
+}
+
+// Binds the next swapchain image to the swapchain output. Returns false if the swapchain is out of date
+static bool acquireSwapchainImage(RenderGraph* graph) {
+    StromboliContext* context = graph->context;
+    StromboliSwapchain* swapchain = graph->swapchain;
+    VkResult acquireResult = vkAcquireNextImageKHR(context->device, swapchain->swapchain, UINT64_MAX, graph->imageAcquireSemaphores[graph->frameSlot], 0, &graph->swapchainImageIndex);
+    if(acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+        return false;
+    }
+    ASSERT(acquireResult == VK_SUCCESS || acquireResult == VK_SUBOPTIMAL_KHR);
+    graph->swapchainImageAcquired = true;
+
+    StromboliImage* finalImage = &graph->images[getImageHandleData(graph->finalImageHandle)];
+    finalImage->image = swapchain->images[graph->swapchainImageIndex];
+    finalImage->view = swapchain->imageViews[graph->swapchainImageIndex];
+    return true;
+}
+
+// Resets all command pools and events of the frame slot. The fence of the slot must have been waited for
+static void resetFrameSlot(RenderGraph* graph, u32 frameSlot) {
+    StromboliContext* context = graph->context;
+    for(u32 i = 0; i < graph->passCount; ++i) {
+        graph->sortedPasses[i].commandBuffer = 0;
+        graph->sortedPasses[i].replayed = false;
+    }
+    for(u32 i = frameSlot; i < graph->eventCount; i += RENDER_GRAPH_FRAMES_IN_FLIGHT) {
+        vkResetEvent(context->device, graph->events[i]);
+    }
+    vkResetCommandPool(context->device, graph->commandPools[frameSlot], 0);
+    if(graph->asyncCommandPools[0]) {
+        vkResetCommandPool(context->device, graph->asyncCommandPools[frameSlot], 0);
+    }
+    for(u32 i = 0; i < graph->recordingThreadCount; ++i) {
+        struct RenderGraphThreadPool* threadPool = &graph->threadPools[i];
+        for(u32 queue = 0; queue < RENDER_GRAPH_QUEUE_COUNT; ++queue) {
+            vkResetCommandPool(context->device, threadPool->commandPools[frameSlot][queue], 0);
+            threadPool->primaryCommandBuffers[frameSlot][queue].usedCount = 0;
+        }
+        threadPool->secondaryCommandBuffers[frameSlot].usedCount = 0;
+    }
+}
+
+// Relative images are allocated for the full output size and only rendered into their top left part while the render scale is below 1
+static VkExtent2D getRenderExtent(RenderGraph* graph, u32 imageIndex) {
+    StromboliImage* image = &graph->images[imageIndex];
+    struct RenderGraphImagePlacement* placement = &graph->imagePlacements[imageIndex];
+    VkExtent2D result = {image->width, image->height};
+    if(placement->widthScale > 0.0f && placement->memoryType != UINT32_MAX && graph->renderScale < 1.0f) {
+        result.width = getScaledSize(image->width, graph->renderScale);
+        result.height = getScaledSize(image->height, graph->renderScale);
+    }
+    return result;
+}
+
+// Graph image or the view of the subresource selected by the attachment
+static StromboliImage* getAttachmentImage(RenderGraph* graph, struct RenderAttachment* attachment) {
+    if(attachment->subresourceIndex != UINT32_MAX) {
+        ASSERT(attachment->subresourceIndex < graph->subresourceCount);
+        return &graph->subresources[attachment->subresourceIndex].image;
+    }
+    u32 imageIndex = getImageHandleData(attachment->imageHandle);
+    ASSERT(imageIndex < graph->imageCount);
+    return &graph->images[imageIndex];
+}
+
+// Graph image or the view of the subresource selected by a handle of the application. Binary search over the sorted subresources
+static StromboliImage* getHandleImage(RenderGraph* graph, RenderGraphImageHandle imageHandle) {
+    u32 imageIndex = getImageHandleData(imageHandle);
+    ASSERT(imageIndex < graph->imageCount);
+    if(!getImageSubresourceData(imageHandle)) {
+        return &graph->images[imageIndex];
+    }
+    u64 key = getSubresourceKey(imageHandle);
+    u32 first = 0;
+    u32 last = graph->subresourceCount;
+    while(first < last) {
+        u32 middle = first + (last - first) / 2;
+        if(getSubresourceKey(graph->subresources[middle].handle) < key) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    ASSERT(first < graph->subresourceCount && getSubresourceKey(graph->subresources[first].handle) == key); // The subresource is not used by any pass
+    return &graph->subresources[first].image;
+}
+
+// Render extent of the mip level selected by the handle
+static VkExtent2D getAttachmentRenderExtent(RenderGraph* graph, RenderGraphImageHandle imageHandle) {
+    VkExtent2D result = getRenderExtent(graph, getImageHandleData(imageHandle));
+    u32 mip = getImageHandleMip(imageHandle);
+    if(mip != UINT32_MAX) {
+        result.width = MAX(result.width >> mip, 1);
+        result.height = MAX(result.height >> mip, 1);
+    }
+    return result;
+}
+
+// Frame time controller. GPU time mostly scales with the pixel count so the scale follows the square root of the time ratio.
+// The square root is approximated around 1 which is accurate enough as the ratio is clamped and only part of the correction is applied
+static void updateRenderScale(RenderGraph* graph) {
+    if(graph->targetFrameTime <= 0.0f || graph->lastDuration <= 0.0f) {
+        return;
+    }
+    float ratio = CLAMP(0.5f, graph->targetFrameTime / graph->lastDuration, 2.0f);
+    float desiredScale = graph->renderScale * (1.0f + ratio) * 0.5f;
+    float scale = graph->renderScale + (desiredScale - graph->renderScale) * RENDER_GRAPH_RENDER_SCALE_SMOOTHING;
+    graph->renderScale = CLAMP(RENDER_GRAPH_MIN_RENDER_SCALE, scale, 1.0f);
+}
+
+// Copies the rendered part of the readback image into the ring entry of the current execution. Format conversion is done by blitting into the output of the pass first
+static void recordReadback(RenderGraph* graph, struct RenderGraphReadback* readback, VkCommandBuffer commandBuffer) {
+    u32 entry = graph->executionCount % RENDER_GRAPH_READBACK_RING_SIZE;
+    StromboliImage* image = &graph->images[readback->imageIndex];
+    VkExtent2D extent = getRenderExtent(graph, readback->imageIndex);
+    VkImageAspectFlags aspect = isDepthFormat(image->format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    if(readback->blitSourceIndex != UINT32_MAX) {
+        VkOffset3D size = {(s32)extent.width, (s32)extent.height, 1};
+        VkImageBlit region = (VkImageBlit){
+            .srcSubresource.layerCount = 1,
+            .srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .srcOffsets[1] = size,
+            .dstSubresource.layerCount = 1,
+            .dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .dstOffsets[1] = size,
+        };
+        vkCmdBlitImage(commandBuffer, graph->images[readback->blitSourceIndex].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+        VkImageMemoryBarrier2KHR imageBarrier = stromboliCreateImageBarrier(image->image,
+            VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        stromboliPipelineBarrier(commandBuffer, 0, 0, 0, 1, &imageBarrier);
+    }
+
+    // A buffer row length of 0 packs the rows tightly regardless of the tiling of the image
+    VkBufferImageCopy region = {
+        .imageSubresource.aspectMask = aspect,
+        .imageSubresource.layerCount = 1,
+        .imageExtent = {extent.width, extent.height, 1},
+    };
+    StromboliBuffer* buffer = &readback->buffers[entry];
+    vkCmdCopyImageToBuffer(commandBuffer, image->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer->buffer, 1, &region);
+
+    VkBufferMemoryBarrier2KHR bufferBarrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR};
+    bufferBarrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+    bufferBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    bufferBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer = buffer->buffer;
+    bufferBarrier.size = VK_WHOLE_SIZE;
+    if(readback->blitSourceIndex != UINT32_MAX) {
+        // The compiled barriers expect the conversion image in the layout of the pass output
+        VkImageMemoryBarrier2KHR imageBarrier = stromboliCreateImageBarrier(image->image,
+            VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        stromboliPipelineBarrier(commandBuffer, 0, 1, &bufferBarrier, 1, &imageBarrier);
+    } else {
+        stromboliPipelineBarrier(commandBuffer, 0, 1, &bufferBarrier, 0, 0);
+    }
+
+    readback->executionIndices[entry] = graph->executionCount;
+    readback->extents[entry] = extent;
+}
+
 RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle passHandle) {
+    return beginRenderPassOnThread(graph, passHandle, 0);
+}
+
+// Static passes begun on other threads are recorded like any other pass
+static bool isRecordingStatic(RenderGraph* graph, RenderGraphPass* pass) {
+    return pass->staticPass && pass->commandBuffer == graph->staticCommandBuffers[pass->queue][pass->staticCommandBufferIndex + graph->frameSlot];
+}
+
+// Executes the secondary command buffers, ends rendering and hands resources over to the other queue
+static void endPassRendering(RenderGraph* graph, RenderGraphPass* pass) {
+    VkCommandBuffer commandBuffer = pass->commandBuffer;
+    if(pass->secondaryCommandBufferCount) {
+        // Indices that were not handed out are skipped
+        u32 secondaryCount = 0;
+        for(u32 i = 0; i < pass->secondaryCommandBufferCount; ++i) {
+            if(pass->secondaryCommandBuffers[i]) {
+                pass->secondaryCommandBuffers[secondaryCount++] = pass->secondaryCommandBuffers[i];
+            }
+        }
+        if(secondaryCount) {
+            vkCmdExecuteCommands(commandBuffer, secondaryCount, pass->secondaryCommandBuffers);
+        }
+    }
+    if(pass->type == RENDER_GRAPH_PASS_TYPE_GRAPHICS) {
+        vkCmdEndRenderingKHR(commandBuffer);
+    }
+    if(pass->releaseImageBarrierCount || pass->releaseBufferBarrierCount) {
+        stromboliPipelineBarrier(commandBuffer, 0, pass->releaseBufferBarrierCount, pass->releaseBufferBarriers, pass->releaseImageBarrierCount, pass->releaseImageBarriers);
+    }
+}
+
+// Signals split barriers of later passes on this queue and writes the end timestamps of sorted pass passIndex
+static void finishPass(RenderGraph* graph, u32 passIndex) {
+    RenderGraphPass* pass = &graph->sortedPasses[passIndex];
+    VkCommandBuffer commandBuffer = pass->commandBuffer;
+    u32 frameSlot = graph->frameSlot;
+    for(u32 j = 0; j < pass->eventSetCount; ++j) {
+        u32 dependencyIndex = pass->eventSets[j];
+        vkCmdSetEvent2KHR(commandBuffer, graph->events[dependencyIndex * RENDER_GRAPH_FRAMES_IN_FLIGHT + frameSlot], &graph->eventDependencies[dependencyIndex].dependencyInfo);
+    }
+
+    if(passIndex < graph->timedPassCount) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, graph->queryPools[frameSlot], 3 + passIndex*2);
+    }
+    if(passIndex == graph->passCount -1) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, graph->queryPools[frameSlot], 1);
+        graph->pendingTimestampCounts[frameSlot] = 2 + graph->timedPassCount * 2;
+        graph->pendingTimedPassCounts[frameSlot] = graph->timedPassCount;
+    }
+
+    #ifdef TRACY_ENABLE
+    if(!isRecordingStatic(graph, pass)) {
+        destroyTracyStromboliScope(&pass->tracyScope);
+    }
+    #endif
+}
+
+// Only touches the pass itself and memory of the calling thread. So different passes can be recorded concurrently
+RenderGraphPass* beginRenderPassOnThread(RenderGraph* graph, RenderGraphPassHandle passHandle, u32 threadIndex) {
+    ASSERT(threadIndex == 0 || threadIndex < graph->recordingThreadCount); // Did you call renderGraphSetRecordingThreadCount?
     MemoryArena* scratch = threadContextGetScratch(0);
     ArenaTempMemory temp = arenaBeginTemp(scratch);
 
@@ -12,37 +287,123 @@ RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle passH
     ASSERT(getPassFingerprint(passHandle) == graph->fingerprint);
 
     u32 passHandleValue = getPassHandleData(passHandle);
-    ASSERT(passHandleValue <= graph->passCount);
+    ASSERT(passHandleValue <= graph->buildPassCount);
 
     RenderGraphPass* pass = 0;
     if(passHandleValue > 0) {
         u32 sortedHandle = graph->buildPassToSortedPass[passHandleValue-1];
-        if(sortedHandle != UINT32_MAX) {
+        if(sortedHandle != UINT16_MAX) {
             pass = &graph->sortedPasses[sortedHandle];
         }
     }
 
+    bool swapchainPass = graph->swapchain && pass == &graph->sortedPasses[graph->swapchainOutputPassIndex];
+    if(swapchainPass && !acquireSwapchainImage(graph)) {
+        // Swapchain is out of date. renderGraphExecute returns false so the caller can resize
+        pass = 0;
+    }
+
     if(pass) {
-        VkCommandBuffer commandBuffer = graph->commandBuffers[(pass - graph->sortedPasses)+graph->commandBufferOffset];
+        u32 sortedPassIndex = (u32)(pass - graph->sortedPasses);
+        bool batchedWithNext = sortedPassIndex + 1 < graph->passCount && graph->sortedPasses[sortedPassIndex + 1].batched;
+        ASSERT(threadIndex == 0 || (!pass->batched && !batchedWithNext)); // Batched passes can only be recorded on thread 0
+        VkCommandBuffer commandBuffer = 0;
+        bool recordStatic = pass->staticPass && threadIndex == 0;
+        if(recordStatic) {
+            commandBuffer = graph->staticCommandBuffers[pass->queue][pass->staticCommandBufferIndex + graph->frameSlot];
+            if(pass->staticRenderScales[graph->frameSlot] == graph->renderScale) {
+                // Recorded in an earlier execution of this frame slot. Nothing to record for the application
+                pass->commandBuffer = commandBuffer;
+                pass->replayed = true;
+                arenaEndTemp(temp);
+                return 0;
+            }
+            // Might still be recording if the execution that began it was dropped
+            vkResetCommandBuffer(commandBuffer, 0);
+        } else if(pass->batched) {
+            RenderGraphPass* previous = pass - 1;
+            ASSERT(!pass->secondaryCommandBufferCount && !previous->secondaryCommandBufferCount); // Excluded from batching during compilation
+            if(!previous->commandBuffer && previous->readback) {
+                // Readback passes the application does not record are begun right before the next pass of their command buffer
+                RenderGraphPassHandle previousHandle = {(previous->readback->buildPassIndex + 1) | (graph->fingerprint << FINGERPRINT_SHIFT)};
+                beginRenderPassOnThread(graph, previousHandle, 0);
+            }
+            ASSERT(previous->commandBuffer); // Batched passes have to be begun in execution order
+            endPassRendering(graph, previous);
+            finishPass(graph, sortedPassIndex - 1);
+            commandBuffer = previous->commandBuffer;
+        } else if(threadIndex == 0) {
+            VkCommandBuffer* commandBuffers = graph->commandBuffers;
+            if(pass->queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE) {
+                commandBuffers = graph->asyncCommandBuffers;
+            }
+            commandBuffer = commandBuffers[pass->commandBufferIndex+graph->frameSlot*graph->commandBufferCountPerFrame];
+        } else {
+            commandBuffer = getThreadCommandBuffer(graph, &graph->threadPools[threadIndex], graph->frameSlot, pass->queue, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        }
         pass->commandBuffer = commandBuffer;
 
-        VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        if(!pass->batched) {
+            VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+            beginInfo.flags = recordStatic ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        }
 
         if(pass == &graph->sortedPasses[0]) {
             // First command buffer
-            vkCmdResetQueryPool(commandBuffer, graph->queryPools[0], 0, 2);
-            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, graph->queryPools[0], 0);
-            graph->timestampCount++;
+            vkCmdResetQueryPool(commandBuffer, graph->queryPools[graph->frameSlot], 0, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, graph->queryPools[graph->frameSlot], 0);
+        }
+        if(sortedPassIndex < graph->timedPassCount) {
+            // Every pass resets its own queries so passes on other queues or threads never touch them
+            vkCmdResetQueryPool(commandBuffer, graph->queryPools[graph->frameSlot], 2 + sortedPassIndex*2, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, graph->queryPools[graph->frameSlot], 2 + sortedPassIndex*2);
         }
 
         #ifdef TRACY_ENABLE
-        pass->tracyScope = createTracyStromboliScopeAllocSource( getTracyContext(), __LINE__, __FILE__, strlen( __FILE__ ), __FUNCTION__, strlen(__FUNCTION__), (const char*)pass->name.base, pass->name.size, commandBuffer, true);
+        // Tracy zones are collected every execution so static command buffers cannot contain them
+        if(!recordStatic) {
+            pass->tracyScope = createTracyStromboliScopeAllocSource( getTracyContext(), __LINE__, __FILE__, strlen( __FILE__ ), __FUNCTION__, strlen(__FUNCTION__), (const char*)pass->name.base, pass->name.size, commandBuffer, true);
+        }
         #endif
 
-        // Layout transitions
-        stromboliPipelineBarrier(commandBuffer, 0, 0, 0, pass->imageBarrierCount, pass->imageBarriers);
+        if(pass->eventWaitCount) {
+            // Split barriers. The earlier passes have set the events at their end
+            VkEvent* events = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, pass->eventWaitCount, VkEvent);
+            VkDependencyInfoKHR* dependencyInfos = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, pass->eventWaitCount, VkDependencyInfoKHR);
+            for(u32 i = 0; i < pass->eventWaitCount; ++i) {
+                u32 dependencyIndex = pass->firstEventWait + i;
+                events[i] = graph->events[dependencyIndex * RENDER_GRAPH_FRAMES_IN_FLIGHT + graph->frameSlot];
+                dependencyInfos[i] = graph->eventDependencies[dependencyIndex].dependencyInfo;
+            }
+            vkCmdWaitEvents2KHR(commandBuffer, pass->eventWaitCount, events, dependencyInfos);
+        }
+
+        // Layout transitions. All barriers of a pass form a single dependency
+        VkImageMemoryBarrier2KHR* imageBarriers = pass->imageBarriers;
+        u32 imageBarrierCount = pass->imageBarrierCount;
+        if(swapchainPass) {
+            imageBarriers = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, imageBarrierCount + 1, VkImageMemoryBarrier2KHR);
+            MEMORY_COPY(imageBarriers, pass->imageBarriers, sizeof(VkImageMemoryBarrier2KHR) * imageBarrierCount);
+            imageBarriers[imageBarrierCount] = graph->finalImageBarrier;
+            imageBarriers[imageBarrierCount++].image = graph->images[getImageHandleData(graph->finalImageHandle)].image;
+        }
+        if(pass->bufferBarrierCount || imageBarrierCount) {
+            stromboliPipelineBarrier(commandBuffer, 0, pass->bufferBarrierCount, pass->bufferBarriers, imageBarrierCount, imageBarriers);
+        }
+
+        // Buffer clears happen outside of rendering for all pass types
+        for(u32 i = 0; i < pass->bufferOutputCount; ++i) {
+            struct RenderBufferAttachment output = pass->bufferOutputs[i];
+            if(output.requiresClear) {
+                ASSERT(getBufferFingerprint(output.bufferHandle) == graph->fingerprint);
+                u32 bufferHandleData = getBufferHandleData(output.bufferHandle);
+                vkCmdFillBuffer(commandBuffer, graph->buffers[bufferHandleData].buffer, 0, VK_WHOLE_SIZE, graph->bufferClearValues[bufferHandleData]);
+            }
+        }
+        if(pass->afterClearBufferBarrierCount > 0) {
+            stromboliPipelineBarrier(commandBuffer, 0, pass->afterClearBufferBarrierCount, pass->afterClearBufferBarriers, 0, 0);
+        }
         
         if(pass->type == RENDER_GRAPH_PASS_TYPE_GRAPHICS) {
             ASSERT(pass->outputCount > 0);
@@ -51,6 +412,7 @@ RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle passH
             renderingInfo.layerCount = 1;
             VkRenderingAttachmentInfo* attachments = ARENA_PUSH_ARRAY(scratch, pass->outputCount, VkRenderingAttachmentInfo);
             renderingInfo.pColorAttachments = attachments;
+            pass->depthAttachmentFormat = VK_FORMAT_UNDEFINED;
             for(u32 i = 0; i < pass->outputCount; ++i) {
                 struct RenderAttachment output = pass->outputs[i];
                 if(output.resolveTarget) {
@@ -59,20 +421,26 @@ RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle passH
                 }
                 ASSERT(getImageFingerprint(output.imageHandle) == graph->fingerprint);
                 u32 imageHandleData = getImageHandleData(output.imageHandle);
-                StromboliImage* outputImage = &graph->images[imageHandleData];
+                StromboliImage* outputImage = getAttachmentImage(graph, &output);
                 if(i == 0) {
-                    stromboliCmdSetViewportAndScissor(commandBuffer, outputImage->width, outputImage->height);
-                    renderingInfo.renderArea = (VkRect2D){{0, 0}, {outputImage->width, outputImage->height}};
-                }
-                VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-                if(output.requiresClear) {
-                    loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                    VkExtent2D renderExtent = getAttachmentRenderExtent(graph, output.imageHandle);
+                    stromboliCmdSetViewportAndScissor(commandBuffer, renderExtent.width, renderExtent.height);
+                    renderingInfo.renderArea = (VkRect2D){{0, 0}, renderExtent};
+                    renderingInfo.layerCount = getAttachmentRange(graph, output.imageHandle).layerCount; // Layered rendering into all selected layers
+                    if(pass->viewMask) {
+                        // View i renders into layer i of the attachment views. layerCount is ignored by multiview rendering
+                        ASSERT(renderingInfo.layerCount >= 32 || (pass->viewMask >> renderingInfo.layerCount) == 0); // The outputs do not contain all layers selected by the view mask
+                        renderingInfo.viewMask = pass->viewMask;
+                        renderingInfo.layerCount = 1;
+                    }
+                    pass->renderExtent = renderExtent;
+                    pass->rasterizationSamples = outputImage->samples;
                 }
                 VkRenderingAttachmentInfo* attachment = ARENA_PUSH_STRUCT(scratch, VkRenderingAttachmentInfo);
                 *attachment = (struct VkRenderingAttachmentInfo) {
                     .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-                    .loadOp = loadOp,
-                    .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                    .loadOp = output.loadOp,
+                    .storeOp = output.storeOp,
                     .imageView = outputImage->view,
                     .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
                 };
@@ -89,10 +457,18 @@ RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle passH
                 if(isDepthFormat(outputImage->format)) {
                     attachment->imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
                     renderingInfo.pDepthAttachment = attachment;
+                    pass->depthAttachmentFormat = outputImage->format;
                 } else {
+                    pass->colorAttachmentFormats[renderingInfo.colorAttachmentCount] = outputImage->format;
                     attachments[renderingInfo.colorAttachmentCount++] = *attachment;
                 }
             }
+            pass->colorAttachmentCount = renderingInfo.colorAttachmentCount;
+            if(pass->secondaryCommandBufferCount) {
+                // The draws are recorded into secondary command buffers by renderPassGetSecondaryCommandBuffer
+                renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+                MEMORY_CLEAR(pass->secondaryCommandBuffers, sizeof(VkCommandBuffer) * pass->secondaryCommandBufferCount);
+            }
             //stromboliCmdBeginRenderpass(pass->commandBuffer, &pass->renderpass, pass->width, pass->height, 0);
             vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
         } else {
@@ -102,26 +478,13 @@ RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle passH
                 u32 imageHandleData = getImageHandleData(output.imageHandle);
                 StromboliImage* outputImage = &graph->images[imageHandleData];
                 bool depth = isDepthFormat(outputImage->format);
+                VkImageSubresourceRange range = getAttachmentRange(graph, output.imageHandle);
                 if(!depth) {
                     if(output.requiresClear) {
-                        VkImageSubresourceRange range = {
-                            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                            .layerCount = 1,
-                            .levelCount = 1,
-                            .baseArrayLayer = 0,
-                            .baseMipLevel = 0,
-                        };
                         vkCmdClearColorImage(commandBuffer, outputImage->image, output.layout, &graph->clearValues[imageHandleData].color, 1, &range);
                     }
                 } else {
                     if(output.requiresClear) {
-                        VkImageSubresourceRange range = {
-                            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
-                            .layerCount = 1,
-                            .levelCount = 1,
-                            .baseArrayLayer = 0,
-                            .baseMipLevel = 0,
-                        };
                         vkCmdClearDepthStencilImage(commandBuffer, outputImage->image, VK_IMAGE_LAYOUT_GENERAL, &graph->clearValues[imageHandleData].depthStencil, 1, &range);
                     }
                 }
@@ -130,6 +493,9 @@ RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle passH
             if(pass->afterClearBarrierCount > 0) {
                 stromboliPipelineBarrier(commandBuffer, 0, 0, 0, pass->afterClearBarrierCount, pass->afterClearBarriers);
             }
+            if(pass->readback) {
+                recordReadback(graph, pass->readback, commandBuffer);
+            }
         }
     }
 
@@ -137,9 +503,20 @@ RenderGraphPass* beginRenderPass(RenderGraph* graph, RenderGraphPassHandle passH
     return pass;
 }
 
+void renderGraphInvalidateStaticPass(RenderGraph* graph, RenderGraphPassHandle passHandle) {
+    ASSERT(getPassFingerprint(passHandle) == graph->fingerprint);
+    u32 passHandleValue = getPassHandleData(passHandle);
+    ASSERT(passHandleValue > 0 && passHandleValue <= graph->buildPassCount);
+    u32 sortedHandle = graph->buildPassToSortedPass[passHandleValue-1];
+    if(sortedHandle != UINT16_MAX) {
+        RenderGraphPass* pass = &graph->sortedPasses[sortedHandle];
+        MEMORY_CLEAR(pass->staticRenderScales, sizeof(pass->staticRenderScales));
+    }
+}
+
 u32 renderGraphGetFrameIndex(RenderGraph* graph) {
     ASSERT(graph->passCount > 0);
-    return graph->commandBufferOffset > 0;
+    return graph->frameSlot;
 }
 
 bool renderPassIsActive(RenderGraphPass* pass) {
@@ -150,41 +527,73 @@ VkCommandBuffer renderPassGetCommandBuffer(RenderGraphPass* pass) {
     return pass->commandBuffer;
 }
 
+VkCommandBuffer renderPassGetSecondaryCommandBuffer(RenderGraphPass* pass, u32 index, u32 threadIndex) {
+    RenderGraph* graph = pass->graph;
+    ASSERT(index < pass->secondaryCommandBufferCount); // Did you call renderPassSetSecondaryCommandBufferCount?
+    ASSERT(!pass->secondaryCommandBuffers[index]); // Every index can only be recorded once per execution
+    ASSERT(threadIndex < graph->recordingThreadCount); // Did you call renderGraphSetRecordingThreadCount?
+    VkCommandBuffer result = getThreadCommandBuffer(graph, &graph->threadPools[threadIndex], graph->frameSlot, RENDER_GRAPH_QUEUE_GRAPHICS, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+    VkCommandBufferInheritanceRenderingInfoKHR renderingInheritance = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR};
+    renderingInheritance.viewMask = pass->viewMask;
+    renderingInheritance.colorAttachmentCount = pass->colorAttachmentCount;
+    renderingInheritance.pColorAttachmentFormats = pass->colorAttachmentFormats;
+    renderingInheritance.depthAttachmentFormat = pass->depthAttachmentFormat;
+    renderingInheritance.rasterizationSamples = pass->rasterizationSamples;
+    VkCommandBufferInheritanceInfo inheritanceInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritanceInfo.pNext = &renderingInheritance;
+    VkCommandBufferBeginInfo beginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    vkBeginCommandBuffer(result, &beginInfo);
+    // Dynamic state is not inherited from the primary command buffer
+    stromboliCmdSetViewportAndScissor(result, pass->renderExtent.width, pass->renderExtent.height);
+
+    pass->secondaryCommandBuffers[index] = result;
+    return result;
+}
+
 StromboliImage* renderPassGetInputResource(RenderGraphPass* pass, RenderGraphImageHandle imageHandle) {
     ASSERT(getImageFingerprint(imageHandle) == pass->graph->fingerprint);
-    u32 imageHandleData = getImageHandleData(imageHandle);
-    StromboliImage* result = &pass->graph->images[imageHandleData];
+    StromboliImage* result = getHandleImage(pass->graph, imageHandle);
     return result;
 }
 
 StromboliImage* renderPassGetOutputResource(RenderGraphPass* pass, RenderGraphImageHandle imageHandle) {
     ASSERT(getImageFingerprint(imageHandle) == pass->graph->fingerprint);
-    u32 imageHandleData = getImageHandleData(imageHandle);
-    StromboliImage* result = &pass->graph->images[imageHandleData];
+    StromboliImage* result = getHandleImage(pass->graph, imageHandle);
     return result;
 }
 
-bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain, VkFence fence) {
-    StromboliContext* context = graph->context;
+StromboliBuffer* renderPassGetBufferResource(RenderGraphPass* pass, RenderGraphBufferHandle bufferHandle) {
+    ASSERT(getBufferFingerprint(bufferHandle) == pass->graph->fingerprint);
+    u32 bufferHandleData = getBufferHandleData(bufferHandle);
+    ASSERT(bufferHandleData < pass->graph->bufferCount);
+    StromboliBuffer* result = &pass->graph->buffers[bufferHandleData];
+    return result;
+}
 
-    // Wait for fence
-    vkWaitForFences(context->device, 1, &fence, true, UINT64_MAX);
-    vkResetFences(context->device, 1, &fence);
+VkExtent2D renderPassGetRenderExtent(RenderGraphPass* pass, RenderGraphImageHandle imageHandle) {
+    ASSERT(getImageFingerprint(imageHandle) == pass->graph->fingerprint);
+    return getAttachmentRenderExtent(pass->graph, imageHandle);
+}
 
-    if(graph->imageDeleteCount) {
-        for(u32 i = 0; i < graph->imageDeleteCount; ++i) {
-            stromboliImageDestroy(context, &graph->imageDeleteQueue[i]);
-        }
-        graph->imageDeleteCount = 0;
-        graph->imageDeleteQueue = 0;
+// Synchronization2 stages beyond the first 32 bits have no legacy equivalent
+static VkPipelineStageFlags getLegacyStageMask(VkPipelineStageFlags2 stage) {
+    if(!stage || (stage >> 32)) {
+        return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
     }
+    return (VkPipelineStageFlags)stage;
+}
 
-    // Read timestamps
+// Must only be called once the fence of frameSlot has been waited for. So this never stalls
+static void readTimestamps(RenderGraph* graph, u32 frameSlot) {
+    StromboliContext* context = graph->context;
     uint64_t timestamps[TIMING_SECTION_COUNT * 2] = { 0 };
-    u32 timestampCount = graph->timestampCount;
+    u32 timestampCount = graph->pendingTimestampCounts[frameSlot];
     ASSERT(timestampCount <= ARRAY_COUNT(timestamps));
     if(timestampCount > 1) {
-        VkResult timestampsValid = vkGetQueryPoolResults(context->device, graph->queryPools[0], 0, timestampCount, sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT);
+        VkResult timestampsValid = vkGetQueryPoolResults(context->device, graph->queryPools[frameSlot], 0, timestampCount, sizeof(timestamps), timestamps, sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT);
         if(timestampsValid == VK_SUCCESS) {
             u32 startIndex = 0;
             u32 endIndex = 1;
@@ -192,34 +601,81 @@ bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain, VkFen
             double end = ((double)timestamps[endIndex]) * context->physicalDeviceProperties.limits.timestampPeriod * 1e-9;
             float delta = (float)(end - begin);
             graph->lastDuration = delta;
+
+            u32 timedPassCount = graph->pendingTimedPassCounts[frameSlot];
+            if(timedPassCount) {
+                ASSERT(timedPassCount == graph->timedPassCount);
+                for(u32 i = 0; i < timedPassCount; ++i) {
+                    double passBegin = ((double)timestamps[2 + i*2]) * context->physicalDeviceProperties.limits.timestampPeriod * 1e-9;
+                    double passEnd = ((double)timestamps[3 + i*2]) * context->physicalDeviceProperties.limits.timestampPeriod * 1e-9;
+                    graph->passTimingSamples[i * graph->timingWindow + graph->nextTimingSample] = (float)MAX(passEnd - passBegin, 0.0);
+                }
+                graph->nextTimingSample = (graph->nextTimingSample + 1) % graph->timingWindow;
+                graph->timingSampleCount = MIN(graph->timingSampleCount + 1, graph->timingWindow);
+            }
         } else {
             graph->lastDuration = 0.0f;
         }
-    } else {
-        graph->lastDuration = 0.0f;
     }
-    graph->timestampCount = 0;
+    graph->pendingTimestampCounts[frameSlot] = 0;
+    graph->pendingTimedPassCounts[frameSlot] = 0;
+}
 
-    // Acquire image
-    u32 imageIndex;
-    VkResult acquireResult = vkAcquireNextImageKHR(context->device, swapchain->swapchain, UINT64_MAX, graph->imageAcquireSemaphore, 0, &imageIndex);
-    if(acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
-        // Swapchain is out of date and must be resized
-        return false;
+// Destroys resources of previous compilations and resizes once the executions that might use them have finished. Never blocks
+static void flushDeleteQueues(RenderGraph* graph) {
+    if(graph->retiredGraph && graph->executionCount >= graph->retiredExecutionCount + RENDER_GRAPH_FRAMES_IN_FLIGHT) {
+        // The fence of the first execution of this graph has been waited for. As it was submitted after every execution of the retired graph
+        // on the graphics queue, which also joins the async work of each execution, the retired graph is idle and its destruction does not block
+        renderGraphDestroy(graph->retiredGraph);
+        graph->retiredGraph = 0;
     }
-    ASSERT(acquireResult == VK_SUCCESS || acquireResult == VK_SUBOPTIMAL_KHR);
+    destroyRetiredResources(graph, false);
+}
 
-    VkImage image = swapchain->images[imageIndex];
-    VkImageView imageView = swapchain->imageViews[imageIndex];
+// Ends the command buffers of all passes. With a swapchain the final image is blitted into swapchain image imageIndex and prepared for presenting.
+// Without a swapchain the final image is transitioned into finalLayout instead
+static void endPasses(RenderGraph* graph, StromboliSwapchain* swapchain, u32 imageIndex, VkImageLayout finalLayout) {
+    VkImage image = swapchain ? swapchain->images[imageIndex] : 0;
+
+    // Readback passes have nothing to record for the application so they may be skipped. Begun in execution order for pass batching
+    for(u32 i = 0; i < graph->passCount; ++i) {
+        struct RenderGraphReadback* readback = graph->sortedPasses[i].readback;
+        if(readback && !graph->sortedPasses[i].commandBuffer) {
+            RenderGraphPassHandle passHandle = {(readback->buildPassIndex + 1) | (graph->fingerprint << FINGERPRINT_SHIFT)};
+            beginRenderPassOnThread(graph, passHandle, 0);
+        }
+    }
 
     for(u32 i = 0; i < graph->passCount; ++i) {
         VkCommandBuffer commandBuffer = graph->sortedPasses[i].commandBuffer;
         ASSERT(commandBuffer); // If this triggers, this pass has not been submitted!
-        if(graph->sortedPasses[i].type == RENDER_GRAPH_PASS_TYPE_GRAPHICS) {
-            vkCmdEndRenderingKHR(commandBuffer);
+        if(i + 1 < graph->passCount && graph->sortedPasses[i+1].batched) {
+            // Already finished when the next pass of the command buffer was begun
+            continue;
         }
+        if(graph->sortedPasses[i].replayed) {
+            // Static command buffers contain the whole pass including its end
+            if(i == graph->passCount -1) {
+                graph->pendingTimestampCounts[graph->frameSlot] = 2 + graph->timedPassCount * 2;
+                graph->pendingTimedPassCounts[graph->frameSlot] = graph->timedPassCount;
+            }
+            continue;
+        }
+        endPassRendering(graph, &graph->sortedPasses[i]);
 
-        if(i == graph->swapchainOutputPassIndex) {
+        if(i == graph->swapchainOutputPassIndex && graph->swapchain) {
+            // Rendered directly into the swapchain image so only the transition for presenting is left
+            VkImageMemoryBarrier2KHR imageBarrier = graph->presentBarrier;
+            imageBarrier.image = image;
+            stromboliPipelineBarrier(commandBuffer, 0, 0, 0, 1, &imageBarrier);
+        } else if(i == graph->swapchainOutputPassIndex && !swapchain) {
+            // Offscreen. The caller takes over the final image after this execution
+            VkImageMemoryBarrier2KHR imageBarrier = graph->finalImageBarrier;
+            imageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            imageBarrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+            imageBarrier.newLayout = finalLayout;
+            stromboliPipelineBarrier(commandBuffer, 0, 0, 0, 1, &imageBarrier);
+        } else if(i == graph->swapchainOutputPassIndex) {
             // Layout transition
             VkImageMemoryBarrier2KHR imageBarrier = {0};
             ASSERT(getImageFingerprint(graph->finalImageHandle) == graph->fingerprint);
@@ -234,6 +690,9 @@ bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain, VkFen
                     };
             stromboliPipelineBarrier(commandBuffer, 0, 0, 0, ARRAY_COUNT(imageBarriers), imageBarriers);
 
+            // Only the rendered part of the final image is scaled up to the swapchain
+            VkExtent2D renderExtent = getRenderExtent(graph, imageHandleData);
+            VkOffset3D srcSize = {(s32)renderExtent.width, (s32)renderExtent.height, 1};
             VkOffset3D blitSize;
             blitSize.x = swapchain->width;
             blitSize.y = swapchain->height;
@@ -241,12 +700,13 @@ bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain, VkFen
             VkImageBlit region = (VkImageBlit){
                 .srcSubresource.layerCount = 1,
                 .srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .srcOffsets[1] = blitSize,
+                .srcOffsets[1] = srcSize,
                 .dstSubresource.layerCount = 1,
                 .dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
                 .dstOffsets[1] = blitSize,
             };
-            vkCmdBlitImage(commandBuffer, finalImage->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+            VkFilter filter = (srcSize.x == blitSize.x && srcSize.y == blitSize.y) ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+            vkCmdBlitImage(commandBuffer, finalImage->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, filter);
             
             // Layout transition
             imageBarrier = stromboliCreateImageBarrier(image, 
@@ -255,30 +715,186 @@ bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain, VkFen
             stromboliPipelineBarrier(commandBuffer, 0, 0, 0, 1, &imageBarrier);
         }
 
-        if(i == graph->passCount -1) {
-            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, graph->queryPools[0], 1);
-            graph->timestampCount++;
+        finishPass(graph, i);
+        if(isRecordingStatic(graph, &graph->sortedPasses[i])) {
+            graph->sortedPasses[i].staticRenderScales[graph->frameSlot] = graph->renderScale;
+        } else {
+            collectTracyStromboli(commandBuffer);
         }
 
-        #ifdef TRACY_ENABLE
-            destroyTracyStromboliScope(&graph->sortedPasses[i].tracyScope);
-        #endif
-        collectTracyStromboli(commandBuffer);
-
         vkEndCommandBuffer(commandBuffer);
     }
+    if(graph->swapchain) {
+        // The swapchain image is not owned by the graph and must never be destroyed with the graph images
+        StromboliImage* finalImage = &graph->images[getImageHandleData(graph->finalImageHandle)];
+        finalImage->image = 0;
+        finalImage->view = 0;
+    }
+}
+
+// Submits the batches of the current frame slot and signals its fence. imageIndex is UINT32_MAX for offscreen executions which do not wait for an acquired image.
+// timelineValue is signaled on the timeline semaphore together with the fence if it is not 0
+static void submitBatches(RenderGraph* graph, u32 imageIndex, u64 timelineValue) {
+    StromboliContext* context = graph->context;
+    u32 frameSlot = graph->frameSlot;
+    VkFence fence = graph->frameFences[frameSlot]; // Already waited for when the previous execution advanced to this slot
+
+    // Submit batches in sorted order. This way every semaphore signal is submitted before its wait
+    VkQueue queues[RENDER_GRAPH_QUEUE_COUNT];
+    queues[RENDER_GRAPH_QUEUE_GRAPHICS] = context->graphicsQueues[0].queue;
+    queues[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE] = context->computeQueueCount ? context->computeQueues[0].queue : context->graphicsQueues[0].queue;
+    u32 lastGraphicsBatch = 0;
+    bool usesAsyncQueue = false;
+    for(u32 i = 0; i < graph->batchCount; ++i) {
+        if(graph->batches[i].queue == RENDER_GRAPH_QUEUE_GRAPHICS) {
+            lastGraphicsBatch = i;
+        } else {
+            usesAsyncQueue = true;
+        }
+    }
+    // Binary semaphores ignore their signal value
+    u64 signalValues[2] = {timelineValue, timelineValue};
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+    timelineInfo.pSignalSemaphoreValues = signalValues;
+    MemoryArena* scratch = threadContextGetScratch(0);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+    vkResetFences(context->device, 1, &fence);
+
+    // Consecutive executions share images, buffers and memory. First accesses wait for the previous execution on the same queue
+    // in their barriers. Work of the previous execution on the other queue is waited for by the first batch on each queue.
+    // An empty submission signals the semaphore after everything submitted to its queue so far. As async work of the next
+    // execution only starts once the graphics work of this one has finished, executions do not overlap across queues
+    bool separateQueues = queues[RENDER_GRAPH_QUEUE_GRAPHICS] != queues[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE];
+    bool frameSignals[RENDER_GRAPH_QUEUE_COUNT];
+    frameSignals[RENDER_GRAPH_QUEUE_GRAPHICS] = separateQueues && usesAsyncQueue;
+    frameSignals[RENDER_GRAPH_QUEUE_ASYNC_COMPUTE] = separateQueues && graph->asyncQueueUsed;
+    for(u32 queue = 0; queue < RENDER_GRAPH_QUEUE_COUNT; ++queue) {
+        if(frameSignals[queue]) {
+            VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &graph->frameSemaphores[frameSlot][queue];
+            vkQueueSubmit(queues[queue], 1, &submitInfo, 0);
+        }
+    }
+    graph->asyncQueueUsed = usesAsyncQueue;
+    bool queueStarted[RENDER_GRAPH_QUEUE_COUNT] = {false, false};
+    for(u32 i = 0; i < graph->batchCount; ++i) {
+        struct RenderGraphSubmitBatch* batch = &graph->batches[i];
+        VkCommandBuffer* commandBuffers = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, batch->passCount, VkCommandBuffer);
+        u32 commandBufferCount = 0;
+        for(u32 j = 0; j < batch->passCount; ++j) {
+            RenderGraphPass* pass = &graph->sortedPasses[batch->firstPass + j];
+            if(!pass->batched) {
+                commandBuffers[commandBufferCount++] = pass->commandBuffer;
+            }
+        }
+
+        VkSemaphore waitSemaphores[3];
+        VkPipelineStageFlags waitMasks[3];
+        u32 waitCount = 0;
+        u32 otherQueue = (batch->queue == RENDER_GRAPH_QUEUE_GRAPHICS) ? RENDER_GRAPH_QUEUE_ASYNC_COMPUTE : RENDER_GRAPH_QUEUE_GRAPHICS;
+        if(!queueStarted[batch->queue] && frameSignals[otherQueue]) {
+            waitSemaphores[waitCount] = graph->frameSemaphores[frameSlot][otherQueue];
+            waitMasks[waitCount++] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        }
+        queueStarted[batch->queue] = true;
+        if(batch->waitBatch != UINT32_MAX) {
+            waitSemaphores[waitCount] = graph->batches[batch->waitBatch].signalSemaphores[frameSlot];
+            waitMasks[waitCount++] = getLegacyStageMask(batch->waitStage);
+        }
+        if(imageIndex != UINT32_MAX && graph->swapchainOutputPassIndex >= batch->firstPass && graph->swapchainOutputPassIndex < batch->firstPass + batch->passCount) {
+            waitSemaphores[waitCount] = graph->imageAcquireSemaphores[frameSlot];
+            waitMasks[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        }
+        VkFence batchFence = 0;
+        if(i == lastGraphicsBatch && graph->joinBatch == UINT32_MAX) {
+            batchFence = fence;
+        }
+        VkSemaphore signalSemaphores[2];
+        u32 signalCount = 0;
+        if(batch->signalSemaphores[frameSlot]) {
+            signalSemaphores[signalCount++] = batch->signalSemaphores[frameSlot];
+        }
+        if(i == lastGraphicsBatch && imageIndex != UINT32_MAX) {
+            signalSemaphores[signalCount++] = graph->imageReleaseSemaphores[imageIndex];
+        }
+        if(batchFence && timelineValue) {
+            signalSemaphores[signalCount++] = graph->timelineSemaphore;
+        }
+        ASSERT(signalCount <= ARRAY_COUNT(signalSemaphores));
+
+        VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submitInfo.commandBufferCount = commandBufferCount;
+        submitInfo.pCommandBuffers = commandBuffers;
+        submitInfo.signalSemaphoreCount = signalCount;
+        submitInfo.pSignalSemaphores = signalSemaphores;
+        submitInfo.waitSemaphoreCount = waitCount;
+        submitInfo.pWaitSemaphores = waitSemaphores;
+        submitInfo.pWaitDstStageMask = waitMasks;
+        if(timelineValue) {
+            timelineInfo.signalSemaphoreValueCount = signalCount;
+            submitInfo.pNext = &timelineInfo;
+        }
+        vkQueueSubmit(queues[batch->queue], 1, &submitInfo, batchFence);
+    }
+    if(graph->joinBatch != UINT32_MAX) {
+        // Async work that no graphics batch waited for. The fence must only signal once it has finished
+        VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &graph->batches[graph->joinBatch].signalSemaphores[frameSlot];
+        VkPipelineStageFlags waitMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        submitInfo.pWaitDstStageMask = &waitMask;
+        if(timelineValue) {
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &graph->timelineSemaphore;
+            timelineInfo.signalSemaphoreValueCount = 1;
+            submitInfo.pNext = &timelineInfo;
+        }
+        vkQueueSubmit(queues[RENDER_GRAPH_QUEUE_GRAPHICS], 1, &submitInfo, fence);
+    }
+    arenaEndTemp(temp);
+}
+
+// Advance to the next frame slot. This only blocks if the GPU is still executing the last frame recorded into it
+static void advanceFrameSlot(RenderGraph* graph) {
+    StromboliContext* context = graph->context;
+    u32 frameSlot = (graph->frameSlot + 1) % RENDER_GRAPH_FRAMES_IN_FLIGHT;
+    graph->frameSlot = frameSlot;
+    graph->executionCount++;
+    vkWaitForFences(context->device, 1, &graph->frameFences[frameSlot], true, UINT64_MAX);
+    readTimestamps(graph, frameSlot);
+    resetFrameSlot(graph, frameSlot);
+    updateRenderScale(graph);
+}
 
-    // Submit
-    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-    submitInfo.commandBufferCount = graph->passCount;
-    submitInfo.pCommandBuffers = graph->commandBuffers + graph->commandBufferOffset;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &graph->imageReleaseSemaphores[imageIndex];
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &graph->imageAcquireSemaphore;
-    VkPipelineStageFlags waitMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    submitInfo.pWaitDstStageMask = &waitMask;
-    vkQueueSubmit(context->graphicsQueues[0].queue, 1, &submitInfo, fence);
+bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain) {
+    StromboliContext* context = graph->context;
+    u32 frameSlot = graph->frameSlot;
+    flushDeleteQueues(graph);
+
+    // Acquire image. When rendering directly into the swapchain this already happened when the swapchain output pass began
+    u32 imageIndex;
+    if(graph->swapchain) {
+        ASSERT(graph->swapchain == swapchain);
+        if(!graph->swapchainImageAcquired) {
+            // Swapchain is out of date and must be resized. Nothing recorded for this frame is submitted
+            resetFrameSlot(graph, frameSlot);
+            return false;
+        }
+        graph->swapchainImageAcquired = false;
+        imageIndex = graph->swapchainImageIndex;
+    } else {
+        VkResult acquireResult = vkAcquireNextImageKHR(context->device, swapchain->swapchain, UINT64_MAX, graph->imageAcquireSemaphores[frameSlot], 0, &imageIndex);
+        if(acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            // Swapchain is out of date and must be resized
+            resetFrameSlot(graph, frameSlot);
+            return false;
+        }
+        ASSERT(acquireResult == VK_SUCCESS || acquireResult == VK_SUBOPTIMAL_KHR);
+    }
+
+    endPasses(graph, swapchain, imageIndex, VK_IMAGE_LAYOUT_UNDEFINED);
+    submitBatches(graph, imageIndex, 0);
 
     // Present
     VkPresentInfoKHR presentInfo = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
@@ -289,12 +905,7 @@ bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain, VkFen
     presentInfo.pImageIndices = &imageIndex;
     VkResult presentResult = vkQueuePresentKHR(context->graphicsQueues[0].queue, &presentInfo);
 
-    if(graph->commandBufferOffset) {
-        graph->commandBufferOffset = 0;
-    } else {
-        graph->commandBufferOffset = graph->commandBufferCountPerFrame;
-    }
-    vkResetCommandPool(context->device, graph->commandPools[!!graph->commandBufferOffset], 0);
+    advanceFrameSlot(graph);
     
     if(presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
         vkQueueWaitIdle(context->graphicsQueues[0].queue);
@@ -303,6 +914,92 @@ bool renderGraphExecute(RenderGraph* graph, StromboliSwapchain* swapchain, VkFen
     return true;
 }
 
+u64 renderGraphExecuteOffscreen(RenderGraph* graph, VkImageLayout finalLayout) {
+    ASSERT(!graph->swapchain); // Rendering directly into a swapchain image requires renderGraphExecute
+    ASSERT(finalLayout != VK_IMAGE_LAYOUT_UNDEFINED);
+    StromboliContext* context = graph->context;
+    flushDeleteQueues(graph);
+
+    if(!graph->timelineSemaphore) {
+        // Enabled with StromboliInitializationParameters.timelineSemaphore on Vulkan 1.2 or later
+        ASSERT(context->timelineSemaphore);
+        VkSemaphoreTypeCreateInfo typeInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = graph->timelineValue;
+        VkSemaphoreCreateInfo createInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+        createInfo.pNext = &typeInfo;
+        vkCreateSemaphore(context->device, &createInfo, 0, &graph->timelineSemaphore);
+    }
+
+    u64 timelineValue = ++graph->timelineValue;
+    endPasses(graph, 0, 0, finalLayout);
+    submitBatches(graph, UINT32_MAX, timelineValue);
+    advanceFrameSlot(graph);
+    return timelineValue;
+}
+
+void renderGraphWaitOffscreen(RenderGraph* graph, u64 timelineValue) {
+    if(!graph->timelineSemaphore || !timelineValue) {
+        return;
+    }
+    VkSemaphoreWaitInfo waitInfo = {VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &graph->timelineSemaphore;
+    waitInfo.pValues = &timelineValue;
+    vkWaitSemaphores(graph->context->device, &waitInfo, UINT64_MAX);
+}
+
+VkSemaphore renderGraphGetTimelineSemaphore(RenderGraph* graph) {
+    return graph->timelineSemaphore;
+}
+
+u64 renderGraphGetExecutionIndex(RenderGraph* graph) {
+    return graph->executionCount;
+}
+
+// Execution e was recorded into frame slot e % RENDER_GRAPH_FRAMES_IN_FLIGHT. Its fence can only belong to a newer execution once that has been submitted
+bool renderGraphGetReadback(RenderGraph* graph, RenderGraphPassHandle readbackPass, u64 executionIndex, bool wait, struct RenderGraphReadbackData* result) {
+    ASSERT(getPassFingerprint(readbackPass) == graph->fingerprint);
+    u32 passHandleValue = getPassHandleData(readbackPass);
+    struct RenderGraphReadback* readback = 0;
+    for(u32 i = 0; i < graph->readbackCount; ++i) {
+        if(graph->readbacks[i].buildPassIndex + 1 == passHandleValue) {
+            readback = &graph->readbacks[i];
+        }
+    }
+    ASSERT(readback); // Not a readback pass or pruned while compiling
+    u32 entry = executionIndex % RENDER_GRAPH_READBACK_RING_SIZE;
+    if(!readback || executionIndex >= graph->executionCount || readback->executionIndices[entry] != executionIndex) {
+        return false;
+    }
+
+    StromboliContext* context = graph->context;
+    if(executionIndex + RENDER_GRAPH_FRAMES_IN_FLIGHT > graph->executionCount) {
+        VkFence fence = graph->frameFences[executionIndex % RENDER_GRAPH_FRAMES_IN_FLIGHT];
+        if(wait) {
+            vkWaitForFences(context->device, 1, &fence, true, UINT64_MAX);
+        } else if(vkGetFenceStatus(context->device, fence) != VK_SUCCESS) {
+            return false;
+        }
+    }
+
+    StromboliBuffer* buffer = &readback->buffers[entry];
+    // Required for memory that is not host coherent
+    VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+    range.memory = buffer->memory;
+    range.size = VK_WHOLE_SIZE;
+    vkInvalidateMappedMemoryRanges(context->device, 1, &range);
+
+    VkExtent2D extent = readback->extents[entry];
+    result->data = buffer->mapped;
+    result->width = extent.width;
+    result->height = extent.height;
+    result->texelSize = readback->texelSize;
+    result->size = (u64)extent.width * extent.height * readback->texelSize;
+    result->format = graph->images[readback->imageIndex].format;
+    return true;
+}
+
 // Result in seconds
 float renderGraphGetLastDuration(RenderGraph* graph) {
     float result = 0.0f;
@@ -312,19 +1009,83 @@ float renderGraphGetLastDuration(RenderGraph* graph) {
     return result;
 }
 
-void renderGraphDestroy(RenderGraph* graph, VkFence fence) {
-    StromboliContext* context = graph->context;
+void renderGraphSetTimingWindow(RenderGraph* graph, u32 frameCount) {
+    ASSERT(frameCount);
+    frameCount = MAX(frameCount, 1);
+    if(frameCount != graph->timingWindow) {
+        // Old samples are lost until the next recompilation resets the arena
+        graph->timingWindow = frameCount;
+        graph->passTimingSamples = ARENA_PUSH_ARRAY(&graph->arena, graph->timedPassCount * graph->timingWindow, float);
+        graph->timingSampleCount = 0;
+        graph->nextTimingSample = 0;
+    }
+}
 
-    // Wait for fence
-    vkWaitForFences(context->device, 1, &fence, true, UINT64_MAX);
-    vkResetFences(context->device, 1, &fence);
+void renderGraphSetRenderScale(RenderGraph* graph, float scale) {
+    ASSERT(scale > 0.0f && scale <= 1.0f);
+    graph->renderScale = CLAMP(0.01f, scale, 1.0f);
+}
+
+float renderGraphGetRenderScale(RenderGraph* graph) {
+    return graph->renderScale;
+}
+
+void renderGraphSetTargetFrameTime(RenderGraph* graph, float seconds) {
+    graph->targetFrameTime = MAX(seconds, 0.0f);
+}
 
-    if(graph->imageDeleteCount) {
-        for(u32 i = 0; i < graph->imageDeleteCount; ++i) {
-            stromboliImageDestroy(context, &graph->imageDeleteQueue[i]);
+u32 renderGraphGetPassTimings(RenderGraph* graph, struct RenderGraphPassTiming* timings, u32 maxTimingCount) {
+    u32 timingCount = MIN(graph->timedPassCount, maxTimingCount);
+    u32 sampleCount = graph->timingSampleCount;
+    MemoryArena* scratch = threadContextGetScratch(0);
+    ArenaTempMemory temp = arenaBeginTemp(scratch);
+    float* sortedSamples = ARENA_PUSH_ARRAY_NO_CLEAR(scratch, sampleCount, float);
+    u32 lastSample = (graph->nextTimingSample + graph->timingWindow - 1) % graph->timingWindow;
+    for(u32 i = 0; i < timingCount; ++i) {
+        struct RenderGraphPassTiming* timing = &timings[i];
+        *timing = (struct RenderGraphPassTiming){0};
+        timing->name = graph->sortedPasses[i].name;
+        if(!sampleCount) {
+            continue;
+        }
+
+        // Insertion sort is fine for the small windows used here
+        float* samples = &graph->passTimingSamples[i * graph->timingWindow];
+        double sum = 0.0;
+        for(u32 j = 0; j < sampleCount; ++j) {
+            float sample = samples[j];
+            sum += sample;
+            u32 k = j;
+            while(k > 0 && sortedSamples[k-1] > sample) {
+                sortedSamples[k] = sortedSamples[k-1];
+                --k;
+            }
+            sortedSamples[k] = sample;
         }
-        graph->imageDeleteCount = 0;
-        graph->imageDeleteQueue = 0;
+        timing->last = samples[lastSample];
+        timing->mean = (float)(sum / sampleCount);
+        timing->min = sortedSamples[0];
+        timing->p95 = sortedSamples[((sampleCount - 1) * 95) / 100];
+    }
+    arenaEndTemp(temp);
+    return timingCount;
+}
+
+void renderGraphDestroy(RenderGraph* graph) {
+    StromboliContext* context = graph->context;
+    if(graph->retiredGraph) {
+        renderGraphDestroy(graph->retiredGraph);
+    }
+    if(graph->pendingGraph) {
+        renderGraphDestroy(graph->pendingGraph);
+    }
+
+    // Wait for all pending executions
+    vkWaitForFences(context->device, RENDER_GRAPH_FRAMES_IN_FLIGHT, graph->frameFences, true, UINT64_MAX);
+
+    destroyRetiredResources(graph, true);
+    for(u32 i = 0; i < graph->subresourceCount; ++i) {
+        vkDestroyImageView(context->device, graph->subresources[i].image.view, 0);
     }
 
     struct RenderGraphMemoryBlock* memoryBlock = graph->firstBlock;
@@ -333,20 +1094,103 @@ void renderGraphDestroy(RenderGraph* graph, VkFence fence) {
         memoryBlock = memoryBlock->next;
     }
 
-    vkDestroyCommandPool(context->device, graph->commandPools[0], 0);
-    vkDestroyCommandPool(context->device, graph->commandPools[1], 0);
-
-    vkDestroyQueryPool(context->device, graph->queryPools[0], 0);
-    vkDestroyQueryPool(context->device, graph->queryPools[1], 0);
+    for(u32 slot = 0; slot < RENDER_GRAPH_FRAMES_IN_FLIGHT; ++slot) {
+        vkDestroyCommandPool(context->device, graph->commandPools[slot], 0);
+        if(graph->asyncCommandPools[slot]) {
+            vkDestroyCommandPool(context->device, graph->asyncCommandPools[slot], 0);
+        }
+        vkDestroyQueryPool(context->device, graph->queryPools[slot], 0);
+        vkDestroySemaphore(context->device, graph->imageAcquireSemaphores[slot], 0);
+        for(u32 queue = 0; queue < RENDER_GRAPH_QUEUE_COUNT; ++queue) {
+            vkDestroySemaphore(context->device, graph->frameSemaphores[slot][queue], 0);
+        }
+        vkDestroyFence(context->device, graph->frameFences[slot], 0);
+    }
+    for(u32 queue = 0; queue < RENDER_GRAPH_QUEUE_COUNT; ++queue) {
+        if(graph->staticCommandPools[queue]) {
+            vkDestroyCommandPool(context->device, graph->staticCommandPools[queue], 0);
+        }
+    }
+    for(u32 i = 0; i < graph->queueSemaphoreCount; ++i) {
+        vkDestroySemaphore(context->device, graph->queueSemaphores[i], 0);
+    }
+    for(u32 i = 0; i < graph->eventCount; ++i) {
+        vkDestroyEvent(context->device, graph->events[i], 0);
+    }
+    for(u32 i = 0; i < graph->recordingThreadCount; ++i) {
+        for(u32 slot = 0; slot < RENDER_GRAPH_FRAMES_IN_FLIGHT; ++slot) {
+            for(u32 queue = 0; queue < RENDER_GRAPH_QUEUE_COUNT; ++queue) {
+                vkDestroyCommandPool(context->device, graph->threadPools[i].commandPools[slot][queue], 0);
+            }
+        }
+    }
 
-    vkDestroySemaphore(context->device, graph->imageAcquireSemaphore, 0);
     for(u32 i = 0; i < MAX_SWAPCHAIN_IMAGES; ++i) {
         vkDestroySemaphore(context->device, graph->imageReleaseSemaphores[i], 0);
     }
+    if(graph->timelineSemaphore) {
+        vkDestroySemaphore(context->device, graph->timelineSemaphore, 0);
+    }
 
     for(u32 i = 0; i < graph->imageCount; ++i) {
         stromboliImageDestroy(context, &graph->images[i]);
     }
+    for(u32 i = 0; i < graph->bufferCount; ++i) {
+        stromboliDestroyBuffer(context, &graph->buffers[i]);
+    }
+    for(u32 i = 0; i < graph->readbackCount; ++i) {
+        for(u32 j = 0; j < RENDER_GRAPH_READBACK_RING_SIZE; ++j) {
+            stromboliDestroyBuffer(context, &graph->readbacks[i].buffers[j]);
+        }
+    }
+    for(u32 i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
+        if(graph->imageHeaps[i]) {
+            vkFreeMemory(context->device, graph->imageHeaps[i], 0);
+        }
+    }
+    groundedDestroyMutex(&graph->pendingGraphMutex);
 
     MEMORY_CLEAR_STRUCT(graph);
 }
+
+void renderGraphSetPending(RenderGraph* graph, RenderGraph* compiledGraph) {
+    ASSERT(compiledGraph != graph);
+    ASSERT(!compiledGraph->executionCount); // Only freshly compiled graphs can replace another graph
+    groundedLockMutex(&graph->pendingGraphMutex);
+    RenderGraph* replacedGraph = graph->pendingGraph;
+    graph->pendingGraph = compiledGraph;
+    groundedUnlockMutex(&graph->pendingGraphMutex);
+    if(replacedGraph) {
+        // Never executed so nothing has to be waited for
+        renderGraphDestroy(replacedGraph);
+    }
+}
+
+RenderGraph* renderGraphSwapPending(RenderGraph* graph) {
+    groundedLockMutex(&graph->pendingGraphMutex);
+    RenderGraph* result = graph->pendingGraph;
+    graph->pendingGraph = 0;
+    groundedUnlockMutex(&graph->pendingGraphMutex);
+    if(!result) {
+        return graph;
+    }
+
+    // Continue the execution numbering so execution indices and frame slots stay consistent for the application
+    result->executionCount = graph->executionCount;
+    result->frameSlot = graph->frameSlot;
+    result->renderScale = graph->renderScale;
+    result->targetFrameTime = graph->targetFrameTime;
+    if(graph->recordingThreadCount > result->recordingThreadCount) {
+        renderGraphSetRecordingThreadCount(result, graph->recordingThreadCount);
+    }
+    // Timeline values returned by earlier offscreen executions stay valid
+    result->timelineSemaphore = graph->timelineSemaphore;
+    result->timelineValue = graph->timelineValue;
+    graph->timelineSemaphore = 0;
+
+    // Resources of the old graph might still be used by its pending executions. It is destroyed together with the next deletion queue flush
+    // after the first execution of the new graph has finished
+    result->retiredGraph = graph;
+    result->retiredExecutionCount = graph->executionCount;
+    return result;
+}
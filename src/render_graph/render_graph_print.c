@@ -7,9 +7,8 @@
 
 void renderGraphBuilderPrint(RenderGraphBuilder* builder) {
     // Print all passes with all inputs and outputs
-    struct RenderGraphBuildPass* pass = builder->passSentinel.next;
-    u32 index = 0;
-    while(pass) {
+    for(u32 index = 0; index < builder->currentPassIndex - 1; ++index) {
+        struct RenderGraphBuildPass* pass = &builder->passes[index];
         printf("Pass%u: %.*s\n", index, (int)pass->name.size, (const char*)pass->name.base);
 
         printf("\tInputs:\n");
@@ -28,8 +27,25 @@ void renderGraphBuilderPrint(RenderGraphBuilder* builder) {
             printf("\t\tFormat: %u\n", outputImage->format);
         }
 
-        pass = pass->next;
-        ++index;
+        if(pass->bufferInputCount) {
+            printf("\tBuffer inputs:\n");
+            for(u32 i = 0; i < pass->bufferInputCount; ++i) {
+                struct RenderBufferAttachment input = pass->bufferInputs[i];
+                struct RenderGraphBuildBuffer* inputBuffer = getBufferFromHandle(builder, input.bufferHandle);
+                printf("\t\tIndex: %u\n", getBufferHandleData(input.bufferHandle));
+                printf("\t\tSize: %llu\n", (unsigned long long)inputBuffer->size);
+            }
+        }
+
+        if(pass->bufferOutputCount) {
+            printf("\tBuffer outputs:\n");
+            for(u32 i = 0; i < pass->bufferOutputCount; ++i) {
+                struct RenderBufferAttachment output = pass->bufferOutputs[i];
+                struct RenderGraphBuildBuffer* outputBuffer = getBufferFromHandle(builder, output.bufferHandle);
+                printf("\t\tIndex: %u\n", getBufferHandleData(output.bufferHandle));
+                printf("\t\tSize: %llu\n", (unsigned long long)outputBuffer->size);
+            }
+        }
     }
 }
 
@@ -43,6 +59,14 @@ static void printBarrier(VkImageMemoryBarrier2KHR barrier) {
     printf("\t\tNew layout: %s\n", string_VkImageLayout(barrier.newLayout));
 }
 
+static void printBufferBarrier(VkBufferMemoryBarrier2KHR barrier) {
+    printf("\t\tVkBuffer: %p\n", barrier.buffer);
+    printf("\t\tSource stage: %s\n", string_VkPipelineStageFlagBits2(barrier.srcStageMask));
+    printf("\t\tSource access: %s\n", string_VkAccessFlagBits2(barrier.srcAccessMask));
+    printf("\t\tDest stage: %s\n", string_VkPipelineStageFlagBits2(barrier.dstStageMask));
+    printf("\t\tDest access: %s\n", string_VkAccessFlagBits2(barrier.dstAccessMask));
+}
+
 void renderGraphPrint(RenderGraph* graph) {
     for(u32 i = 0; i < graph->passCount * 2; ++i) {
         printf("Command buffer%u: %p\n", i, graph->commandBuffers[i]);
@@ -53,7 +77,20 @@ void renderGraphPrint(RenderGraph* graph) {
         if(passIndex == graph->swapchainOutputPassIndex) {
             printf("\tSwapchain output\n");
         }
-        printf("\tCommand buffer: %p\n", graph->commandBuffers[graph->commandBufferOffset + passIndex]);
+        if(pass.queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE) {
+            printf("\tQueue: async compute\n");
+        } else {
+            printf("\tQueue: graphics\n");
+        }
+        if(pass.staticPass) {
+            printf("\tStatic command buffer: %p\n", graph->staticCommandBuffers[pass.queue][pass.staticCommandBufferIndex + graph->frameSlot]);
+        } else {
+            VkCommandBuffer* commandBuffers = pass.queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE ? graph->asyncCommandBuffers : graph->commandBuffers;
+            printf("\tCommand buffer: %p%s\n", commandBuffers[graph->frameSlot * graph->commandBufferCountPerFrame + pass.commandBufferIndex], pass.batched ? " (batched)" : "");
+        }
+        if(pass.secondaryCommandBufferCount) {
+            printf("\tSecondary command buffers: %u\n", pass.secondaryCommandBufferCount);
+        }
 
         printf("\tBarriers:\n");
         for(u32 i = 0; i < pass.imageBarrierCount; ++i) {
@@ -61,6 +98,41 @@ void renderGraphPrint(RenderGraph* graph) {
             printBarrier(barrier);
         }
 
+        if(pass.bufferBarrierCount) {
+            printf("\tBuffer barriers:\n");
+            for(u32 i = 0; i < pass.bufferBarrierCount; ++i) {
+                printBufferBarrier(pass.bufferBarriers[i]);
+            }
+        }
+
+        for(u32 i = 0; i < pass.eventWaitCount; ++i) {
+            struct RenderGraphEventDependency dependency = graph->eventDependencies[pass.firstEventWait + i];
+            printf("\tSplit barriers set by pass%u:\n", dependency.setPass);
+            for(u32 j = 0; j < dependency.dependencyInfo.imageMemoryBarrierCount; ++j) {
+                printBarrier(dependency.imageBarriers[j]);
+            }
+            for(u32 j = 0; j < dependency.dependencyInfo.bufferMemoryBarrierCount; ++j) {
+                printBufferBarrier(dependency.bufferBarriers[j]);
+            }
+        }
+
+        if(pass.afterClearBufferBarrierCount) {
+            printf("\tAfter clear buffer barriers:\n");
+            for(u32 i = 0; i < pass.afterClearBufferBarrierCount; ++i) {
+                printBufferBarrier(pass.afterClearBufferBarriers[i]);
+            }
+        }
+
+        if(pass.releaseImageBarrierCount || pass.releaseBufferBarrierCount) {
+            printf("\tQueue release barriers:\n");
+            for(u32 i = 0; i < pass.releaseImageBarrierCount; ++i) {
+                printBarrier(pass.releaseImageBarriers[i]);
+            }
+            for(u32 i = 0; i < pass.releaseBufferBarrierCount; ++i) {
+                printBufferBarrier(pass.releaseBufferBarriers[i]);
+            }
+        }
+
         if(pass.afterClearBarrierCount) {
             printf("\tAfter clear barriers:\n");
             for(u32 i = 0; i < pass.afterClearBarrierCount; ++i) {
@@ -75,6 +147,9 @@ void renderGraphPrint(RenderGraph* graph) {
             struct StromboliImage* inputImage = &graph->images[getImageHandleData(input.imageHandle)];
             printf("\tInput%u:\n", i);
             printf("\t\tImage Index: %u\n", getImageHandleData(input.imageHandle));
+            if(getImageSubresourceData(input.imageHandle)) {
+                printf("\t\tSubresource: Mip %d Layer %d\n", (s32)getImageHandleMip(input.imageHandle), (s32)getImageHandleLayer(input.imageHandle));
+            }
             printf("\t\tVkImage: %p\n", inputImage->image);
             printf("\t\tVkImageView: %p\n", inputImage->view);
             printf("\t\tFormat: %s\n", string_VkFormat(inputImage->format));
@@ -89,21 +164,70 @@ void renderGraphPrint(RenderGraph* graph) {
             struct StromboliImage* outputImage = &graph->images[getImageHandleData(output.imageHandle)];
             printf("\tOutput%u:\n", i);
             printf("\t\tImage Index: %u\n", getImageHandleData(output.imageHandle));
+            if(getImageSubresourceData(output.imageHandle)) {
+                printf("\t\tSubresource: Mip %d Layer %d\n", (s32)getImageHandleMip(output.imageHandle), (s32)getImageHandleLayer(output.imageHandle));
+            }
             printf("\t\tVkImage: %p\n", outputImage->image);
             printf("\t\tVkImageView: %p\n", outputImage->view);
             printf("\t\tFormat: %s\n", string_VkFormat(outputImage->format));
             printf("\t\tDimensions(WxHxD): %ux%ux%u\n", outputImage->width, outputImage->height, outputImage->depth);
             printf("\t\tMipLevels: %u\n", outputImage->mipCount);
             printf("\t\tSamples: %s\n", string_VkSampleCountFlagBits(outputImage->samples));
+            if(pass.type == RENDER_GRAPH_PASS_TYPE_GRAPHICS && !output.resolveTarget) {
+                printf("\t\tLoad/Store: %s/%s\n", string_VkAttachmentLoadOp(output.loadOp), string_VkAttachmentStoreOp(output.storeOp));
+            }
             if(output.requiresClear) {
                 VkClearValue clearValue = graph->clearValues[getImageHandleData(output.imageHandle)];
                 printf("\t\tCleared with: (%f,%f,%f,%f)\n", clearValue.color.float32[0], clearValue.color.float32[1], clearValue.color.float32[2], clearValue.color.float32[3]);
             }
         }
+
+        for(u32 i = 0; i < pass.bufferInputCount; ++i) {
+            struct RenderBufferAttachment input = pass.bufferInputs[i];
+            StromboliBuffer* inputBuffer = &graph->buffers[getBufferHandleData(input.bufferHandle)];
+            printf("\tBufferInput%u:\n", i);
+            printf("\t\tBuffer Index: %u\n", getBufferHandleData(input.bufferHandle));
+            printf("\t\tVkBuffer: %p\n", inputBuffer->buffer);
+            printf("\t\tSize: %llu\n", (unsigned long long)inputBuffer->size);
+        }
+
+        for(u32 i = 0; i < pass.bufferOutputCount; ++i) {
+            struct RenderBufferAttachment output = pass.bufferOutputs[i];
+            StromboliBuffer* outputBuffer = &graph->buffers[getBufferHandleData(output.bufferHandle)];
+            printf("\tBufferOutput%u:\n", i);
+            printf("\t\tBuffer Index: %u\n", getBufferHandleData(output.bufferHandle));
+            printf("\t\tVkBuffer: %p\n", outputBuffer->buffer);
+            printf("\t\tSize: %llu\n", (unsigned long long)outputBuffer->size);
+            if(output.requiresClear) {
+                printf("\t\tCleared with: 0x%08x\n", graph->bufferClearValues[getBufferHandleData(output.bufferHandle)]);
+            }
+        }
+    }
+    if(graph->swapchain) {
+        printf("\tRenders directly into the swapchain image\n");
     }
     if(graph->finalImageBarrier.image) {
         printf("\tFinal barrier:\n");
         VkImageMemoryBarrier2KHR barrier = graph->finalImageBarrier;
         printBarrier(barrier);
     }
+    for(u32 i = 0; i < graph->batchCount; ++i) {
+        struct RenderGraphSubmitBatch batch = graph->batches[i];
+        printf("Batch%u: %s passes %u-%u\n", i, batch.queue == RENDER_GRAPH_QUEUE_ASYNC_COMPUTE ? "async compute" : "graphics", batch.firstPass, batch.firstPass + batch.passCount - 1);
+        if(batch.waitBatch != UINT32_MAX) {
+            printf("\tWaits for batch%u at %s\n", batch.waitBatch, string_VkPipelineStageFlagBits2(batch.waitStage));
+        }
+        if(i == graph->joinBatch) {
+            printf("\tJoined before the fence\n");
+        }
+    }
+    struct RenderGraphMemoryStatistics memoryStatistics = renderGraphGetMemoryStatistics(graph);
+    printf("Image memory: %llu bytes peak, %llu bytes without aliasing, %llu bytes aliased\n", (unsigned long long)memoryStatistics.peakMemory, (unsigned long long)memoryStatistics.unaliasedMemory, (unsigned long long)memoryStatistics.aliasedMemory);
+    printf("Aliased images: %u/%u\n", memoryStatistics.aliasedImageCount, memoryStatistics.imageCount);
+    printf("Reused images: %u/%u\n", memoryStatistics.reusedImageCount, memoryStatistics.imageCount);
+    printf("Transient images: %u/%u, %llu bytes lazily allocated\n", memoryStatistics.transientImageCount, memoryStatistics.imageCount, (unsigned long long)memoryStatistics.lazilyAllocatedMemory);
+    struct RenderGraphBarrierStatistics barrierStatistics = renderGraphGetBarrierStatistics(graph);
+    printf("Barriers: %u, %u removed, %u split\n", barrierStatistics.barrierCount, barrierStatistics.removedBarrierCount, barrierStatistics.splitBarrierCount);
+    struct RenderGraphSubmitStatistics submitStatistics = renderGraphGetSubmitStatistics(graph);
+    printf("Command buffers: %u for %u passes in %u submits\n", submitStatistics.commandBufferCount, submitStatistics.passCount, submitStatistics.submitCount);
 }
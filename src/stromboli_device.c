@@ -184,6 +184,10 @@ StromboliResult initVulkanDevice(StromboliContext* context, StromboliInitializat
             requestedDeviceExtensions[requestedDeviceExtensionCount++] = VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME;
         }
     }
+    if(parameters->multiview && !parameters->dynamicRendering && context->apiVersion < VK_API_VERSION_1_1) {
+        // Promoted to VK_API_VERSION_1_1. Already requested above when dynamic rendering is used
+        requestedDeviceExtensions[requestedDeviceExtensionCount++] = VK_KHR_MULTIVIEW_EXTENSION_NAME;
+    }
     if(parameters->dynamicRenderingUnusedAttachments && context->apiVersion < VK_API_VERSION_1_3) {
         requestedDeviceExtensions[requestedDeviceExtensionCount++] = VK_EXT_DYNAMIC_RENDERING_UNUSED_ATTACHMENTS_EXTENSION_NAME;
     }
@@ -350,6 +354,7 @@ StromboliResult initVulkanDevice(StromboliContext* context, StromboliInitializat
         createInfo.ppEnabledExtensionNames = requestedDeviceExtensions;
         createInfo.pEnabledFeatures = &enabledFeatures;
 
+        VkPhysicalDeviceVulkan11Features features11 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
         VkPhysicalDeviceVulkan12Features features12 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
         VkPhysicalDeviceVulkan13Features features13 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
         VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR};
@@ -359,8 +364,15 @@ StromboliResult initVulkanDevice(StromboliContext* context, StromboliInitializat
         VkPhysicalDeviceDynamicRenderingUnusedAttachmentsFeaturesEXT dynamicRenderingUnusedAttachmentsFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_UNUSED_ATTACHMENTS_FEATURES_EXT};
         VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES};
         VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR};
+        VkPhysicalDeviceMultiviewFeatures multiviewFeatures = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES};
 
         if(context->apiVersion >= VK_API_VERSION_1_2) {
+            // Vulkan11Features and the individual 1.1 feature structs must not be chained together
+            if(parameters->multiview) {
+                features11.multiview = true;
+                *pNextChain = &features11;
+                pNextChain = &features11.pNext;
+            }
             features12.bufferDeviceAddress = parameters->bufferDeviceAddress;
             features12.scalarBlockLayout = parameters->scalarBlockLayout;
             features12.shaderSampledImageArrayNonUniformIndexing = parameters->nonUniformIndexingSampledImageArray;
@@ -391,6 +403,12 @@ StromboliResult initVulkanDevice(StromboliContext* context, StromboliInitializat
             pNextChain = &descriptorIndexingFeatures.pNext;
         }
 
+        if(context->apiVersion < VK_API_VERSION_1_2 && parameters->multiview) { // Also valid for VK_KHR_multiview
+            multiviewFeatures.multiview = true;
+            *pNextChain = &multiviewFeatures;
+            pNextChain = &multiviewFeatures.pNext;
+        }
+
         if(context->apiVersion >= VK_API_VERSION_1_3) {
             features13.dynamicRendering = parameters->dynamicRendering;
             // When using Vulkan 1.3 we always enable synchronization2
@@ -439,6 +457,7 @@ StromboliResult initVulkanDevice(StromboliContext* context, StromboliInitializat
             error = STROMBOLI_MAKE_ERROR(STROMBOLI_DEVICE_CREATE_ERROR, "Failed to create vulkan logical device");
         } else {
             volkLoadDevice(context->device);
+            context->timelineSemaphore = parameters->timelineSemaphore && context->apiVersion >= VK_API_VERSION_1_2;
 
             // Acquire queues
             u32 currentQueueIndex = 0;